@@ -50,10 +50,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <time.h>             // For random number generation
 #include <math.h>             // For ceil function
 #include "include/curl/curl.h" // cURL for downloading JSON data
 #include <limits.h>
+#include <ctype.h>
 // Memory struct for cURL response
 struct Memory {
     char *response;
@@ -123,6 +125,358 @@ int download_json(const char *url, const char *output_file) {
     return 0;
 }
 
+// Scenario cache
+// Downloaded scenario documents are kept in a directory between runs. Bodies
+// are stored under the FNV-1a hash of their content, so identical documents
+// share one file, and an index maps each URL to its body, ETag and
+// Last-Modified. A cached URL is revalidated with If-None-Match and
+// If-Modified-Since: on a 304, and whenever the request fails (e.g. offline),
+// the body is served from disk. A body that no longer matches its hash is
+// treated as missing. When the bodies grow past the size limit the least
+// recently used URLs are dropped.
+
+#define SCENARIO_CACHE_MAGIC 0x31435353u   // "SSC1"
+#define SCENARIO_CACHE_VERSION 1
+#define SCENARIO_CACHE_DEFAULT_DIR "scenario_cache"
+#define SCENARIO_CACHE_DEFAULT_KB 16384
+#define SCENARIO_FETCH_CONNECT_TIMEOUT 10L // Seconds before an unreachable host counts as offline
+
+typedef struct {
+    char url[512];
+    char etag[128];
+    char lastModified[64];
+    unsigned long long int content;   // FNV-1a hash of the body, also its file name
+    long long int size;
+    unsigned long long int lastUsed;
+} ScenarioCacheEntry;
+
+typedef struct {
+    char directory[512];
+    ScenarioCacheEntry *entries;
+    int count;
+    int capacity;
+    long long int maxBytes;
+    unsigned long long int clock;     // Source of lastUsed
+    long long int notModified;        // Revalidated with a 304
+    long long int offlineHits;        // Request failed, served from disk
+    long long int misses;             // Body downloaded
+    long long int evictions;
+} ScenarioCache;
+
+// One request through the cache: what is on disk for the URL and what came back
+typedef struct {
+    const char *url;
+    struct Memory body;
+    char etag[128];                   // Validators of the response
+    char lastModified[64];
+    char *cached;                     // Body on disk for this URL, NULL if none
+    long long int cachedSize;
+    struct curl_slist *headers;
+} ScenarioFetch;
+
+static unsigned long long int scenarioCacheHash(const char *data, size_t size) {
+    unsigned long long int hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static void scenarioCacheBodyPath(const ScenarioCache *cache, unsigned long long int content, char *dest, size_t destSize) {
+    snprintf(dest, destSize, "%s\\%016llx.json", cache->directory, content);
+}
+
+static ScenarioCacheEntry *scenarioCacheFind(ScenarioCache *cache, const char *url) {
+    for (int e = 0; e < cache->count; e++) {
+        if (strcmp(cache->entries[e].url, url) == 0) return &cache->entries[e];
+    }
+    return NULL;
+}
+
+// Body of 'entry' from disk (NUL-terminated), or NULL if it is missing or damaged
+static char *scenarioCacheReadBody(const ScenarioCache *cache, const ScenarioCacheEntry *entry) {
+    char path[1024];
+    scenarioCacheBodyPath(cache, entry->content, path, sizeof(path));
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    char *body = (char *)malloc((size_t)entry->size + 1);
+    bool ok = body != NULL && fread(body, 1, (size_t)entry->size, file) == (size_t)entry->size && fgetc(file) == EOF;
+    fclose(file);
+    if (ok && scenarioCacheHash(body, (size_t)entry->size) == entry->content) {
+        body[entry->size] = '\0';
+        return body;
+    }
+    free(body);
+    return NULL;
+}
+
+// Delete the body file 'content' unless an entry still refers to it
+static void scenarioCacheReleaseBody(const ScenarioCache *cache, unsigned long long int content) {
+    for (int e = 0; e < cache->count; e++) {
+        if (cache->entries[e].content == content) return;
+    }
+    char path[1024];
+    scenarioCacheBodyPath(cache, content, path, sizeof(path));
+    remove(path);
+}
+
+static void scenarioCacheRemove(ScenarioCache *cache, ScenarioCacheEntry *entry) {
+    unsigned long long int content = entry->content;
+    *entry = cache->entries[--cache->count];
+    scenarioCacheReleaseBody(cache, content);
+}
+
+static int scenarioCacheCompareAge(const void *a, const void *b) {
+    unsigned long long int x = ((const ScenarioCacheEntry *)a)->lastUsed, y = ((const ScenarioCacheEntry *)b)->lastUsed;
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// Drop the least recently used URLs until the bodies fit in the limit
+static void scenarioCacheEvict(ScenarioCache *cache) {
+    long long int total = 0;
+    for (int e = 0; e < cache->count; e++) total += cache->entries[e].size;
+    if (total <= cache->maxBytes) return;
+    qsort(cache->entries, cache->count, sizeof(ScenarioCacheEntry), scenarioCacheCompareAge);
+    while (cache->count > 0 && total > cache->maxBytes) {
+        ScenarioCacheEntry *oldest = &cache->entries[cache->count - 1];
+        total -= oldest->size;
+        scenarioCacheRemove(cache, oldest);
+        cache->evictions++;
+    }
+}
+
+// Open the cache in 'directory', creating it if needed (a missing index starts an empty cache)
+bool scenarioCacheOpen(ScenarioCache *cache, const char *directory, long long int maxBytes) {
+    memset(cache, 0, sizeof(*cache));
+    snprintf(cache->directory, sizeof(cache->directory), "%s", directory);
+    cache->maxBytes = maxBytes > 0 ? maxBytes : 1;
+    CreateDirectoryA(directory, NULL);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s\\index.bin", directory);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return true;
+    unsigned int header[4];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != SCENARIO_CACHE_MAGIC ||
+        header[1] != SCENARIO_CACHE_VERSION || header[2] != sizeof(ScenarioCacheEntry)) {
+        fprintf(stderr, "Ignoring scenario cache index %s: unknown format\n", path);
+        fclose(file);
+        return true;
+    }
+    cache->entries = (ScenarioCacheEntry *)calloc(header[3] + 1, sizeof(ScenarioCacheEntry));
+    if (cache->entries != NULL) {
+        cache->capacity = (int)header[3] + 1;
+        cache->count = (int)fread(cache->entries, sizeof(ScenarioCacheEntry), header[3], file);
+    }
+    for (int e = 0; e < cache->count; e++) {
+        cache->entries[e].url[sizeof(cache->entries[e].url) - 1] = '\0';
+        cache->entries[e].etag[sizeof(cache->entries[e].etag) - 1] = '\0';
+        cache->entries[e].lastModified[sizeof(cache->entries[e].lastModified) - 1] = '\0';
+        if (cache->entries[e].lastUsed > cache->clock) cache->clock = cache->entries[e].lastUsed;
+    }
+    fclose(file);
+    return true;
+}
+
+// Write the index (through a temporary file) and free the cache
+bool scenarioCacheClose(ScenarioCache *cache) {
+    scenarioCacheEvict(cache);
+    char path[1024], temporary[1024];
+    snprintf(path, sizeof(path), "%s\\index.bin", cache->directory);
+    snprintf(temporary, sizeof(temporary), "%s\\index.tmp", cache->directory);
+    FILE *file = fopen(temporary, "wb");
+    bool ok = file != NULL;
+    if (ok) {
+        unsigned int header[4] = { SCENARIO_CACHE_MAGIC, SCENARIO_CACHE_VERSION, sizeof(ScenarioCacheEntry), (unsigned int)cache->count };
+        ok = fwrite(header, sizeof(header), 1, file) == 1;
+        ok = ok && fwrite(cache->entries, sizeof(ScenarioCacheEntry), cache->count, file) == (size_t)cache->count;
+        ok = fclose(file) == 0 && ok;
+        remove(path);
+        ok = ok && rename(temporary, path) == 0;
+    }
+    if (!ok) fprintf(stderr, "Failed to write scenario cache index %s\n", path);
+    free(cache->entries);
+    memset(cache, 0, sizeof(*cache));
+    return ok;
+}
+
+void scenarioCachePrintStats(const ScenarioCache *cache) {
+    long long int total = 0;
+    for (int e = 0; e < cache->count; e++) total += cache->entries[e].size;
+    fprintf(stderr, "Scenario cache: %lld hits (%lld not modified, %lld offline), %lld misses, %lld evicted, %d URLs, %lld of %lld KB\n",
+            cache->notModified + cache->offlineHits, cache->notModified, cache->offlineHits, cache->misses, cache->evictions,
+            cache->count, (total + 1023) / 1024, cache->maxBytes / 1024);
+}
+
+// True if the header line starts with 'name' (header names ignore case)
+static bool scenarioHeaderIs(const char *line, size_t length, const char *name) {
+    size_t nameLength = strlen(name);
+    if (length <= nameLength) return false;
+    for (size_t i = 0; i < nameLength; i++) {
+        if (tolower((unsigned char)line[i]) != tolower((unsigned char)name[i])) return false;
+    }
+    return true;
+}
+
+// Keep the ETag and Last-Modified headers of the response
+static size_t scenarioFetchHeader(char *buffer, size_t size, size_t nitems, void *userp) {
+    ScenarioFetch *fetch = (ScenarioFetch *)userp;
+    size_t length = size * nitems;
+    static const char *const names[2] = { "ETag:", "Last-Modified:" };
+    char *targets[2] = { fetch->etag, fetch->lastModified };
+    size_t targetSizes[2] = { sizeof(fetch->etag), sizeof(fetch->lastModified) };
+    for (int h = 0; h < 2; h++) {
+        if (!scenarioHeaderIs(buffer, length, names[h])) continue;
+        size_t nameLength = strlen(names[h]);
+        const char *value = buffer + nameLength;
+        size_t valueLength = length - nameLength;
+        while (valueLength > 0 && (*value == ' ' || *value == '\t')) value++, valueLength--;
+        while (valueLength > 0 && (value[valueLength - 1] == '\r' || value[valueLength - 1] == '\n' || value[valueLength - 1] == ' ')) valueLength--;
+        if (valueLength < targetSizes[h]) {
+            memcpy(targets[h], value, valueLength);
+            targets[h][valueLength] = '\0';
+        }
+    }
+    return length;
+}
+
+// Set up 'curl' to fetch 'url', conditional on the cached copy if there is a usable one
+void scenarioFetchBegin(ScenarioCache *cache, ScenarioFetch *fetch, CURL *curl, const char *url) {
+    memset(fetch, 0, sizeof(*fetch));
+    fetch->url = url;
+    ScenarioCacheEntry *entry = cache != NULL ? scenarioCacheFind(cache, url) : NULL;
+    if (entry != NULL) {
+        fetch->cached = scenarioCacheReadBody(cache, entry);
+        if (fetch->cached == NULL) {
+            scenarioCacheRemove(cache, entry); // Body missing or damaged: fetch it again
+        } else {
+            fetch->cachedSize = entry->size;
+            char header[256];
+            if (entry->etag[0] != '\0') {
+                snprintf(header, sizeof(header), "If-None-Match: %s", entry->etag);
+                fetch->headers = curl_slist_append(fetch->headers, header);
+            }
+            if (entry->lastModified[0] != '\0') {
+                snprintf(header, sizeof(header), "If-Modified-Since: %s", entry->lastModified);
+                fetch->headers = curl_slist_append(fetch->headers, header);
+            }
+        }
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L); // For testing purposes
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L); // For testing purposes
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, SCENARIO_FETCH_CONNECT_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&fetch->body);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, scenarioFetchHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)fetch);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, fetch->headers);
+}
+
+// Store a downloaded body under its hash and point the URL's entry at it
+static void scenarioCacheStore(ScenarioCache *cache, ScenarioFetch *fetch) {
+    unsigned long long int content = scenarioCacheHash(fetch->body.response, fetch->body.size);
+    char path[1024];
+    scenarioCacheBodyPath(cache, content, path, sizeof(path));
+    FILE *file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(fetch->body.response, 1, fetch->body.size, file) == fetch->body.size;
+    ok = file != NULL && fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Could not write scenario cache file: %s\n", path);
+        remove(path);
+        return;
+    }
+    ScenarioCacheEntry *entry = scenarioCacheFind(cache, fetch->url);
+    if (entry == NULL) {
+        if (cache->count == cache->capacity) {
+            int capacity = cache->capacity > 0 ? cache->capacity * 2 : 16;
+            ScenarioCacheEntry *grown = (ScenarioCacheEntry *)realloc(cache->entries, capacity * sizeof(ScenarioCacheEntry));
+            if (grown == NULL) return;
+            cache->entries = grown;
+            cache->capacity = capacity;
+        }
+        entry = &cache->entries[cache->count++];
+        memset(entry, 0, sizeof(*entry));
+        snprintf(entry->url, sizeof(entry->url), "%s", fetch->url);
+        entry->content = content;
+    }
+    unsigned long long int previous = entry->content;
+    entry->content = content;
+    entry->size = (long long int)fetch->body.size;
+    entry->lastUsed = ++cache->clock;
+    snprintf(entry->etag, sizeof(entry->etag), "%s", fetch->etag);
+    snprintf(entry->lastModified, sizeof(entry->lastModified), "%s", fetch->lastModified);
+    if (previous != content) scenarioCacheReleaseBody(cache, previous);
+    scenarioCacheEvict(cache);
+}
+
+// Finish a request set up by scenarioFetchBegin: keep a fresh body, fall back
+// to the cached one on a 304 or a failure, and write the result to
+// 'outputFile' (NULL = nowhere). Returns false if there is no body to use.
+bool scenarioFetchEnd(ScenarioCache *cache, ScenarioFetch *fetch, CURLcode result, long status, const char *outputFile) {
+    const char *body = NULL;
+    size_t size = 0;
+    ScenarioCacheEntry *entry = cache != NULL ? scenarioCacheFind(cache, fetch->url) : NULL;
+    if (result == CURLE_OK && status == 200) {
+        body = fetch->body.response != NULL ? fetch->body.response : "";
+        size = fetch->body.size;
+        if (cache != NULL) {
+            cache->misses++;
+            scenarioCacheStore(cache, fetch);
+        }
+    } else if (fetch->cached != NULL) {
+        body = fetch->cached;
+        size = (size_t)fetch->cachedSize;
+        if (result == CURLE_OK && status == 304) {
+            cache->notModified++;
+        } else {
+            cache->offlineHits++;
+            fprintf(stderr, "Fetching %s failed (%s); using the cached copy.\n", fetch->url,
+                    result != CURLE_OK ? curl_easy_strerror(result) : "unexpected HTTP status");
+        }
+        if (entry != NULL) entry->lastUsed = ++cache->clock;
+    } else if (result != CURLE_OK) {
+        fprintf(stderr, "Fetching %s failed: %s\n", fetch->url, curl_easy_strerror(result));
+    } else {
+        fprintf(stderr, "Fetching %s failed: HTTP %ld\n", fetch->url, status);
+    }
+
+    bool ok = body != NULL;
+    if (ok && outputFile != NULL) {
+        FILE *file = fopen(outputFile, "w");
+        ok = file != NULL;
+        if (ok) {
+            fwrite(body, 1, size, file);
+            fclose(file);
+        } else {
+            fprintf(stderr, "Could not open file for writing: %s\n", outputFile);
+        }
+    }
+    free(fetch->body.response);
+    free(fetch->cached);
+    curl_slist_free_all(fetch->headers);
+    memset(fetch, 0, sizeof(*fetch));
+    return ok;
+}
+
+// Download 'url' to 'outputFile' through the cache; the same contract as download_json
+int scenarioCacheFetch(ScenarioCache *cache, const char *url, const char *outputFile) {
+    CURL *curl = curl_easy_init();
+    if (!curl) {
+        fprintf(stderr, "Curl initialization failed!\n");
+        return 1;
+    }
+    ScenarioFetch fetch;
+    scenarioFetchBegin(cache, &fetch, curl, url);
+    CURLcode res = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    bool ok = scenarioFetchEnd(cache, &fetch, res, status, outputFile);
+    curl_easy_cleanup(curl);
+    return ok ? 0 : 1;
+}
+
 // Function to calculate total attack power with critical hit chance
 typedef struct {
     int attackCount;  // Total attacks performed by the unit
@@ -215,358 +569,219 @@ char* readJsonFromFile(const char* filePath) {
         return NULL;
     }
 
-    fread(buffer, 1, fileSize, file);
-    buffer[fileSize] = '\0'; // Null-terminate
+    size_t bytesRead = fread(buffer, 1, fileSize, file);
+    buffer[bytesRead] = '\0'; // Null-terminate (text mode may read fewer bytes than the file size)
 
     fclose(file);
     return buffer;
 }
 
-// Helper function to extract integer value from JSON
-int extractIntValue(const char* source, const char* key) {
-    char* pos = strstr(source, key);
-    if (pos) {
-        pos = strchr(pos, ':');
-        if (pos) {
-            pos++;
-            while (*pos == ' ' || *pos == '"' || *pos == '\'') pos++;
-            return atoi(pos);
-        }
+// Read-only view of a whole file
+typedef struct {
+    const char *data;        // Not NUL-terminated
+    size_t size;
+    HANDLE file;
+    HANDLE mapping;          // NULL for empty files, which cannot be mapped
+} MappedFile;
+
+// Map 'path' read-only; pages are read from the file cache as they are touched
+bool mapFile(MappedFile *mapped, const char *path) {
+    memset(mapped, 0, sizeof(*mapped));
+    mapped->data = "";
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    mapped->file = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        mapped->file = NULL;
+        return false;
     }
-    fprintf(stderr, "Error: Key %s not found in JSON data.\n", key);
-    return 0; // Default value if key not found
-}
-
-// Helper function to extract long long integer value from JSON
-long long int extractLongLongIntValue(const char* source, const char* key) {
-    char* pos = strstr(source, key);
-    if (pos) {
-        pos = strchr(pos, ':');
-        if (pos) {
-            pos++;
-            while (*pos == ' ' || *pos == '"' || *pos == '\'') pos++;
-            return atoll(pos);
-        }
+    if (size.QuadPart == 0) return true;
+    mapped->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const char *view = mapped->mapping != NULL ? (const char *)MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (view == NULL) {
+        if (mapped->mapping != NULL) CloseHandle(mapped->mapping);
+        CloseHandle(file);
+        memset(mapped, 0, sizeof(*mapped));
+        mapped->data = "";
+        return false;
     }
-    return 0;
+    mapped->data = view;
+    mapped->size = (size_t)size.QuadPart;
+    return true;
 }
 
-// Helper function to extract string value from JSON
-void extractStringValue(const char* source, const char* key, char* dest, size_t destSize) {
-    char* pos = strstr(source, key);
-    if (pos) {
-        pos = strchr(pos, ':');
-        if (pos) {
-            pos++;
-            while (*pos == ' ' || *pos == '"' || *pos == '\'') pos++;
-            char* end = strchr(pos, '"');
-            if (end) {
-                size_t len = end - pos;
-                if (len < destSize) {
-                    strncpy(dest, pos, len);
-                    dest[len] = '\0';
-                } else {
-                    strncpy(dest, pos, destSize - 1);
-                    dest[destSize - 1] = '\0';
-                }
-            }
-        }
+void unmapFile(MappedFile *mapped) {
+    if (mapped->mapping != NULL) {
+        UnmapViewOfFile(mapped->data);
+        CloseHandle(mapped->mapping);
     }
+    if (mapped->file != NULL) {
+        CloseHandle(mapped->file);
+    }
+    memset(mapped, 0, sizeof(*mapped));
 }
 
-// Function to parse unit attributes from JSON data manually
-void jsonVerisiniIsleVeBirimOzellikleriniAyarla(const char* jsonVerisi,
-    int *piyadeSaldiri, int *piyadeSavunma, int *piyadeSaglik, int *piyadeKritikSans,
-    int *okcuSaldiri, int *okcuSavunma, int *okcuSaglik, int *okcuKritikSans,
-    int *suvariSaldiri, int *suvariSavunma, int *suvariSaglik, int *suvariKritikSans,
-    int *kusatmaSaldiri, int *kusatmaSavunma, int *kusatmaSaglik, int *kusatmaKritikSans,
-    int *orkSaldiri, int *orkSavunma, int *orkSaglik, int *orkKritikSans,
-    int *mizrakciSaldiri, int *mizrakciSavunma, int *mizrakciSaglik, int *mizrakciKritikSans,
-    int *vargSaldiri, int *vargSavunma, int *vargSaglik, int *vargKritikSans,
-    int *trolSaldiri, int *trolSavunma, int *trolSaglik, int *trolKritikSans) {
-
-    // Piyadeler
-    char* piyadeStr = strstr(jsonVerisi, "\"piyadeler\":");
-    if (piyadeStr != NULL) {
-        *piyadeSaldiri = extractIntValue(piyadeStr, "\"saldiri\"");
-        *piyadeSavunma = extractIntValue(piyadeStr, "\"savunma\"");
-        *piyadeSaglik = extractIntValue(piyadeStr, "\"saglik\"");
-        *piyadeKritikSans = extractIntValue(piyadeStr, "\"kritik_sans\"");
-    }
-
-    // Okular
-    char* okcuStr = strstr(jsonVerisi, "\"okcular\":");
-    if (okcuStr != NULL) {
-        *okcuSaldiri = extractIntValue(okcuStr, "\"saldiri\"");
-        *okcuSavunma = extractIntValue(okcuStr, "\"savunma\"");
-        *okcuSaglik = extractIntValue(okcuStr, "\"saglik\"");
-        *okcuKritikSans = extractIntValue(okcuStr, "\"kritik_sans\"");
-    }
+// JSON index
+// One pass over a document records every value as a token that points into
+// the document (nothing is copied or unescaped). Objects and arrays know how
+// many tokens they span, so a lookup only walks the members of one object
+// and a key can never match inside another object, as a strstr scan could.
+// Token 0 is the document's root value.
 
-    // Svariler
-    char* suvariStr = strstr(jsonVerisi, "\"suvariler\":");
-    if (suvariStr != NULL) {
-        *suvariSaldiri = extractIntValue(suvariStr, "\"saldiri\"");
-        *suvariSavunma = extractIntValue(suvariStr, "\"savunma\"");
-        *suvariSaglik = extractIntValue(suvariStr, "\"saglik\"");
-        *suvariKritikSans = extractIntValue(suvariStr, "\"kritik_sans\"");
-    }
+#define JSON_MAX_DEPTH 64
 
-    // Kuatma Makineleri
-    char* kusatmaStr = strstr(jsonVerisi, "\"kusatma_makineleri\":");
-    if (kusatmaStr != NULL) {
-        *kusatmaSaldiri = extractIntValue(kusatmaStr, "\"saldiri\"");
-        *kusatmaSavunma = extractIntValue(kusatmaStr, "\"savunma\"");
-        *kusatmaSaglik = extractIntValue(kusatmaStr, "\"saglik\"");
-        *kusatmaKritikSans = extractIntValue(kusatmaStr, "\"kritik_sans\"");
-    }
+typedef enum {
+    JSON_OBJECT,
+    JSON_ARRAY,
+    JSON_STRING,             // 'start' is after the opening quote, escapes are kept as written
+    JSON_PRIMITIVE           // Number, true, false or null
+} JsonTokenType;
 
-    // Ork Dvleri
-    char* orkStr = strstr(jsonVerisi, "\"ork_dovusculeri\":");
-    if (orkStr != NULL) {
-        *orkSaldiri = extractIntValue(orkStr, "\"saldiri\"");
-        *orkSavunma = extractIntValue(orkStr, "\"savunma\"");
-        *orkSaglik = extractIntValue(orkStr, "\"saglik\"");
-        *orkKritikSans = extractIntValue(orkStr, "\"kritik_sans\"");
-    }
-
-    // Mzraklar
-    char* mizrakciStr = strstr(jsonVerisi, "\"mizrakcilar\":");
-    if (mizrakciStr != NULL) {
-        *mizrakciSaldiri = extractIntValue(mizrakciStr, "\"saldiri\"");
-        *mizrakciSavunma = extractIntValue(mizrakciStr, "\"savunma\"");
-        *mizrakciSaglik = extractIntValue(mizrakciStr, "\"saglik\"");
-        *mizrakciKritikSans = extractIntValue(mizrakciStr, "\"kritik_sans\"");
-    }
-
-    // Varg Binicileri
-    char* vargStr = strstr(jsonVerisi, "\"varg_binicileri\":");
-    if (vargStr != NULL) {
-        *vargSaldiri = extractIntValue(vargStr, "\"saldiri\"");
-        *vargSavunma = extractIntValue(vargStr, "\"savunma\"");
-        *vargSaglik = extractIntValue(vargStr, "\"saglik\"");
-        *vargKritikSans = extractIntValue(vargStr, "\"kritik_sans\"");
-    }
-
-    // Troller
-    char* trolStr = strstr(jsonVerisi, "\"troller\":");
-    if (trolStr != NULL) {
-        *trolSaldiri = extractIntValue(trolStr, "\"saldiri\"");
-        *trolSavunma = extractIntValue(trolStr, "\"savunma\"");
-        *trolSaglik = extractIntValue(trolStr, "\"saglik\"");
-        *trolKritikSans = extractIntValue(trolStr, "\"kritik_sans\"");
-    }
-}
-
-// Function to parse scenario JSON and extract unit counts and heroes/creatures
-void parseScenarioJson(const char* jsonVerisi, long long int *humanUnitCounts, long long int *orcUnitCounts, char *humanHero, char *humanCreature, char *orcHero, char *orcCreature) {
-    // Parse Human Empire units
-    char* humanStr = strstr(jsonVerisi, "\"insan_imparatorlugu\":");
-    if (humanStr != NULL) {
-        // Units
-        char* birimlerStr = strstr(humanStr, "\"birimler\":");
-        if (birimlerStr != NULL) {
-            humanUnitCounts[0] = extractLongLongIntValue(birimlerStr, "\"piyadeler\"");
-            humanUnitCounts[1] = extractLongLongIntValue(birimlerStr, "\"okcular\"");
-            humanUnitCounts[2] = extractLongLongIntValue(birimlerStr, "\"suvariler\"");
-            humanUnitCounts[3] = extractLongLongIntValue(birimlerStr, "\"kusatma_makineleri\"");
-        }
-
-        // Hero
-        extractStringValue(humanStr, "\"kahraman\"", humanHero, 50);
-
-        // Creature
-        extractStringValue(humanStr, "\"canavar\"", humanCreature, 50);
-    }
-
-    // Parse Orc Legion units
-    char* orcStr = strstr(jsonVerisi, "\"ork_legi\":");
-    if (orcStr != NULL) {
-        // Units
-        char* birimlerStr = strstr(orcStr, "\"birimler\":");
-        if (birimlerStr != NULL) {
-            orcUnitCounts[0] = extractLongLongIntValue(birimlerStr, "\"ork_dovusculeri\"");
-            orcUnitCounts[1] = extractLongLongIntValue(birimlerStr, "\"mizrakcilar\"");
-            orcUnitCounts[2] = extractLongLongIntValue(birimlerStr, "\"varg_binicileri\"");
-            orcUnitCounts[3] = extractLongLongIntValue(birimlerStr, "\"troller\"");
-        }
-
-        // Hero
-        extractStringValue(orcStr, "\"kahraman\"", orcHero, 50);
-
-        // Creature
-        extractStringValue(orcStr, "\"canavar\"", orcCreature, 50);
-    }
-}
-
-
-// Function to apply hero effects
-void kahramanEtkisiUygula(const char* heroesJsonVerisi, const char* heroName, int isHuman,
-    int *piyadeSaldiri, int *piyadeSavunma, int *piyadeKritikSans,
-    int *okcuSaldiri, int *okcuSavunma, int *okcuKritikSans,
-    int *suvariSaldiri, int *suvariSavunma, int *suvariKritikSans,
-    int *kusatmaSaldiri, int *kusatmaSavunma, int *kusatmaKritikSans,
-    int *orkSaldiri, int *orkSavunma, int *orkKritikSans,
-    int *mizrakciSaldiri, int *mizrakciSavunma, int *mizrakciKritikSans,
-    int *vargSaldiri, int *vargSavunma, int *vargKritikSans,
-    int *trolSaldiri, int *trolSavunma, int *trolKritikSans) {
-
-    if (strlen(heroName) == 0) return; // No hero to apply
-
-    char heroKey[100];
-    sprintf(heroKey, "\"%s\":", heroName);
-    char* heroStr = strstr(heroesJsonVerisi, heroKey);
-    if (heroStr != NULL) {
-        char bonusTuru[20];
-        int bonusDegeri;
-
-        extractStringValue(heroStr, "\"bonus_turu\"", bonusTuru, sizeof(bonusTuru));
-        bonusDegeri = extractIntValue(heroStr, "\"bonus_degeri\"");
-
-        if (strcmp(bonusTuru, "saldiri") == 0) {
-            if (isHuman) {
-                if (strcmp(heroName, "Alparslan") == 0) {
-                    *piyadeSaldiri = *piyadeSaldiri * (100 + bonusDegeri) / 100;
-                } else if (strcmp(heroName, "Fatih_Sultan_Mehmet") == 0) {
-                    *kusatmaSaldiri = *kusatmaSaldiri * (100 + bonusDegeri) / 100;
-                } else if (strcmp(heroName, "Tugrul_Bey") == 0) {
-                    *okcuSaldiri = *okcuSaldiri * (100 + bonusDegeri) / 100;
-                }
-            } else {
-                if (strcmp(heroName, "Goruk_Vahsi") == 0) {
-                    *orkSaldiri = *orkSaldiri * (100 + bonusDegeri) / 100;
-                }
-            }
-        } else if (strcmp(bonusTuru, "savunma") == 0) {
-            if (isHuman) {
-                if (strcmp(heroName, "Mete_Han") == 0) {
-                    *okcuSavunma = *okcuSavunma * (100 + bonusDegeri) / 100;
-                }
-            } else {
-                if (strcmp(heroName, "Thruk_Kemikkiran") == 0) {
-                    *trolSavunma = *trolSavunma * (100 + bonusDegeri) / 100;
-                } else if (strcmp(heroName, "Ugar_Zalim") == 0) {
-                    *orkSavunma = *orkSavunma * (100 + bonusDegeri) / 100;
-                    *mizrakciSavunma = *mizrakciSavunma * (100 + bonusDegeri) / 100;
-                    *vargSavunma = *vargSavunma * (100 + bonusDegeri) / 100;
-                    *trolSavunma = *trolSavunma * (100 + bonusDegeri) / 100;
-                }
-            }
-        } else if (strcmp(bonusTuru, "kritik_sans") == 0) {
-            if (isHuman) {
-                if (strcmp(heroName, "Yavuz_Sultan_Selim") == 0) {
-                    *suvariKritikSans += bonusDegeri;
-                }
-            } else {
-                if (strcmp(heroName, "Vrog_Kafakiran") == 0) {
-                    *vargKritikSans += bonusDegeri;
-                }
-            }
-        }
+typedef struct {
+    JsonTokenType type;
+    const char *start;
+    int length;
+    int size;                // Tokens spanned including this one (1 for strings and primitives)
+} JsonToken;
+
+typedef struct {
+    const char *json;
+    JsonToken *tokens;
+    int count;
+    int capacity;
+} JsonIndex;
+
+static int jsonIndexAdd(JsonIndex *index, JsonTokenType type, const char *start, int length) {
+    if (index->count == index->capacity) {
+        int capacity = index->capacity > 0 ? index->capacity * 2 : 64;
+        JsonToken *tokens = (JsonToken *)realloc(index->tokens, capacity * sizeof(JsonToken));
+        if (tokens == NULL) return -1;
+        index->tokens = tokens;
+        index->capacity = capacity;
     }
+    JsonToken *token = &index->tokens[index->count];
+    token->type = type;
+    token->start = start;
+    token->length = length;
+    token->size = 1;
+    return index->count++;
 }
 
-// Function to apply creature effects
-void canavarEtkisiUygula(const char* creaturesJsonVerisi, const char* creatureName, int isHuman,
-    int *piyadeSaldiri, int *piyadeSavunma, int *piyadeKritikSans,
-    int *okcuSaldiri, int *okcuSavunma, int *okcuKritikSans,
-    int *suvariSaldiri, int *suvariSavunma, int *suvariKritikSans,
-    int *kusatmaSaldiri, int *kusatmaSavunma, int *kusatmaKritikSans,
-    int *orkSaldiri, int *orkSavunma, int *orkKritikSans,
-    int *mizrakciSaldiri, int *mizrakciSavunma, int *mizrakciKritikSans,
-    int *vargSaldiri, int *vargSavunma, int *vargKritikSans,
-    int *trolSaldiri, int *trolSavunma, int *trolKritikSans) {
-
-    if (strlen(creatureName) == 0) return; // No creature to apply
-
-    char creatureKey[100];
-    sprintf(creatureKey, "\"%s\":", creatureName);
-    char* creatureStr = strstr(creaturesJsonVerisi, creatureKey);
-    if (creatureStr != NULL) {
-        char etkiTuru[20];
-        int etkiDegeri;
-
-        extractStringValue(creatureStr, "\"etki_turu\"", etkiTuru, sizeof(etkiTuru));
-        etkiDegeri = extractIntValue(creatureStr, "\"etki_degeri\"");
-
-        if (strcmp(etkiTuru, "saldiri") == 0) {
-            if (isHuman) {
-                if (strcmp(creatureName, "Ejderha") == 0) {
-                    *piyadeSaldiri = *piyadeSaldiri * (100 + etkiDegeri) / 100;
-                    *okcuSaldiri = *okcuSaldiri * (100 + etkiDegeri) / 100;
-                    *suvariSaldiri = *suvariSaldiri * (100 + etkiDegeri) / 100;
-                    *kusatmaSaldiri = *kusatmaSaldiri * (100 + etkiDegeri) / 100;
-                } else if (strcmp(creatureName, "Tepegoz") == 0) {
-                    *okcuSaldiri = *okcuSaldiri * (100 + etkiDegeri) / 100;
-                }
-            } else {
-                if (strcmp(creatureName, "Kara_Troll") == 0) {
-                    *trolSaldiri = *trolSaldiri * (100 + etkiDegeri) / 100;
-                }
-            }
-        } else if (strcmp(etkiTuru, "savunma") == 0) {
-            if (isHuman) {
-                if (strcmp(creatureName, "Karakurt") == 0) {
-                    *okcuSavunma = *okcuSavunma * (100 + etkiDegeri) / 100;
-                }
-            } else {
-                if (strcmp(creatureName, "Golge_Kurtlari") == 0) {
-                    *vargSavunma = *vargSavunma * (100 + etkiDegeri) / 100;
-                }
+void jsonIndexFree(JsonIndex *index) {
+    free(index->tokens);
+    memset(index, 0, sizeof(*index));
+}
+
+// Tokenize the 'length' bytes at 'json' (no terminator needed, so a mapped
+// file can be indexed in place); they must stay alive while the index is
+// used. Returns false (with an empty index) for unbalanced or unterminated
+// documents.
+bool jsonIndexBuild(JsonIndex *index, const char *json, size_t length) {
+    memset(index, 0, sizeof(*index));
+    index->json = json;
+    int stack[JSON_MAX_DEPTH];
+    int depth = 0;
+    const char *pos = json;
+    const char *end = json + length;
+    bool ok = true;
+    while (ok && pos < end) {
+        char c = *pos;
+        if (c == '{' || c == '[') {
+            int token = depth < JSON_MAX_DEPTH ? jsonIndexAdd(index, c == '{' ? JSON_OBJECT : JSON_ARRAY, pos, 0) : -1;
+            ok = token >= 0;
+            if (ok) stack[depth++] = token;
+            pos++;
+        } else if (c == '}' || c == ']') {
+            ok = depth > 0 && index->tokens[stack[depth - 1]].type == (c == '}' ? JSON_OBJECT : JSON_ARRAY);
+            if (ok) {
+                JsonToken *open = &index->tokens[stack[--depth]];
+                open->size = index->count - stack[depth];
+                open->length = (int)(pos + 1 - open->start);
             }
-        } else if (strcmp(etkiTuru, "kritik_sans") == 0) {
-            if (isHuman) {
-                // For example, "Ejderha" increases critical chance
-                if (strcmp(creatureName, "Ejderha") == 0) {
-                    *suvariKritikSans += etkiDegeri;
-                }
-            } else {
-                if (strcmp(creatureName, "Kara_Troll") == 0) {
-                    *trolKritikSans += etkiDegeri;
-                }
+            pos++;
+        } else if (c == '"') {
+            const char *start = ++pos;
+            while (pos < end && *pos != '"') {
+                if (*pos == '\\' && pos + 1 < end) pos++;
+                pos++;
             }
+            ok = pos < end && jsonIndexAdd(index, JSON_STRING, start, (int)(pos - start)) >= 0;
+            pos++;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ':') {
+            pos++;
+        } else if (c == '\0') {
+            ok = false;
+        } else {
+            const char *start = pos;
+            while (pos < end && *pos != '\0' && strchr(" \t\r\n,:]}", *pos) == NULL) pos++;
+            ok = jsonIndexAdd(index, JSON_PRIMITIVE, start, (int)(pos - start)) >= 0;
         }
     }
+    if (!ok || depth != 0 || index->count == 0) {
+        jsonIndexFree(index);
+        return false;
+    }
+    return true;
 }
 
-// Function to apply research effects
-void arastirmaEtkisiUygula(const char* researchJsonVerisi, int savunmaUstaligiSeviye, int saldiriGelistirmesiSeviye,
-    int *piyadeSaldiri, int *piyadeSavunma,
-    int *okcuSaldiri, int *okcuSavunma,
-    int *suvariSaldiri, int *suvariSavunma,
-    int *kusatmaSaldiri, int *kusatmaSavunma,
-    int *orkSaldiri, int *orkSavunma,
-    int *mizrakciSaldiri, int *mizrakciSavunma,
-    int *vargSaldiri, int *vargSavunma,
-    int *trolSaldiri, int *trolSavunma) {
+// Key token of the member after 'member' of 'object' (-1 = first); -1 at the end
+int jsonNextMember(const JsonIndex *index, int object, int member) {
+    if (object < 0 || object >= index->count || index->tokens[object].type != JSON_OBJECT) return -1;
+    int next = member < 0 ? object + 1 : member + 1 + index->tokens[member + 1].size;
+    return next + 1 < object + index->tokens[object].size ? next : -1;
+}
 
-    // Apply defense mastery
-    if (savunmaUstaligiSeviye > 0) {
-        char key[50];
-        sprintf(key, "\"savunma_ustaligi\":");
-        char* savunmaStr = strstr(researchJsonVerisi, key);
-        if (savunmaStr != NULL) {
-            int bonusDegeri = extractIntValue(savunmaStr, "\"deger\"");
-            *piyadeSavunma = *piyadeSavunma * (100 + bonusDegeri) / 100;
-            *okcuSavunma = *okcuSavunma * (100 + bonusDegeri) / 100;
-            *suvariSavunma = *suvariSavunma * (100 + bonusDegeri) / 100;
-            *kusatmaSavunma = *kusatmaSavunma * (100 + bonusDegeri) / 100;
+// Value token of 'key' directly inside 'object', or -1
+int jsonFind(const JsonIndex *index, int object, const char *key) {
+    size_t length = strlen(key);
+    for (int member = jsonNextMember(index, object, -1); member >= 0; member = jsonNextMember(index, object, member)) {
+        const JsonToken *token = &index->tokens[member];
+        if (token->type == JSON_STRING && (size_t)token->length == length && memcmp(token->start, key, length) == 0) {
+            return member + 1;
         }
     }
+    return -1;
+}
 
-    // Apply attack development
-    if (saldiriGelistirmesiSeviye > 0) {
-        char key[50];
-        sprintf(key, "\"saldiri_gelistirmesi\":");
-        char* saldiriStr = strstr(researchJsonVerisi, key);
-        if (saldiriStr != NULL) {
-            int bonusDegeri = extractIntValue(saldiriStr, "\"deger\"");
-            *orkSaldiri = *orkSaldiri * (100 + bonusDegeri) / 100;
-            *mizrakciSaldiri = *mizrakciSaldiri * (100 + bonusDegeri) / 100;
-            *vargSaldiri = *vargSaldiri * (100 + bonusDegeri) / 100;
-            *trolSaldiri = *trolSaldiri * (100 + bonusDegeri) / 100;
-        }
+// Leading integer of a token (0 if there is none), read without leaving the token
+static long long int jsonTokenNumber(const JsonToken *token) {
+    const char *pos = token->start;
+    const char *end = pos + token->length;
+    bool negative = pos < end && *pos == '-';
+    if (negative || (pos < end && *pos == '+')) pos++;
+    long long int value = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+        value = value * 10 + (*pos++ - '0');
+    }
+    return negative ? -value : value;
+}
+
+// Integer value of a token; quoted numbers are accepted as well
+int jsonInt(const JsonIndex *index, int token, int fallback) {
+    return token >= 0 ? (int)jsonTokenNumber(&index->tokens[token]) : fallback;
+}
+
+long long int jsonLongLong(const JsonIndex *index, int token, long long int fallback) {
+    return token >= 0 ? jsonTokenNumber(&index->tokens[token]) : fallback;
+}
+
+// Copy a string token to 'dest' (truncated to fit); 'dest' is left alone if it is not a string
+void jsonString(const JsonIndex *index, int token, char *dest, size_t destSize) {
+    if (token < 0 || index->tokens[token].type != JSON_STRING) return;
+    size_t length = index->tokens[token].length < (int)destSize ? (size_t)index->tokens[token].length : destSize - 1;
+    memcpy(dest, index->tokens[token].start, length);
+    dest[length] = '\0';
+}
+
+// Integer member 'key' of 'object', reported on stderr if it is missing
+int jsonIntMember(const JsonIndex *index, int object, const char *key) {
+    int token = jsonFind(index, object, key);
+    if (token < 0) {
+        fprintf(stderr, "Error: Key \"%s\" not found in JSON data.\n", key);
     }
+    return jsonInt(index, token, 0);
 }
 
 // Structure to hold unit information
@@ -595,156 +810,4587 @@ void drawHealthBar(Vector2 position, int currentHealth, int maxHealth, int cellS
 void drawBirimCount(Vector2 position, long long int unitCount);
 void placeUnitsInGrid(Birim *birimler, int birimCount, int cellSize, int startRow, int startCol);
 
-// Function to simulate one battle round with critical hits
-// Simlasyon fonksiyonunu gncelle
-// Function to simulate one battle round with scheduled critical hits
-void simulateRound(Birim *insanImparatorlugu, int insanUnitCount, Birim *orkLegionu, int orkUnitCount, FILE *logFile, int round,int roundNumber,
-                  int *attackCountHuman, int *critThresholdHuman,
-                  int *attackCountOrc, int *critThresholdOrc) {
-    fprintf(logFile, "\n--- Round %d ---\n",round);
-
-    // Yorgunluk yalnzca her fatigueFrequency turda bir uygulanr
-    if (round % 5 == 0) {
-        float fatiguePercentage = 0.10f; // %10 yorgunluk oran
-        for (int i = 0; i < insanUnitCount; i++) {
-            applyFatigueEffect(&insanImparatorlugu[i].saldiri, &insanImparatorlugu[i].savunma, fatiguePercentage);
-        }
-        for (int i = 0; i < orkUnitCount; i++) {
-            applyFatigueEffect(&orkLegionu[i].saldiri, &orkLegionu[i].savunma, fatiguePercentage);
-        }
-        fprintf(logFile, "Yorgunluk devreye girdi: Tur %11d, birimlerin saldr ve savunma gleri %10 azald.\n", round);
-    }
-
-    // Orc birimlerine saldrmak iin bir hedef indeksi tut
-    static int orkAttackIndex = 0;
-    static int insanAttackIndex = 0;
-
-    // HUMAN ATTACK
-    for (int i = 0; i < insanUnitCount; i++) {
-        if (insanImparatorlugu[i].kalanBirimSayisi > 0) {
-            // Increment attack count
-            attackCountHuman[i]++;
-            // Check for critical hit
-            bool isCritical = false;
-            if (attackCountHuman[i] >= critThresholdHuman[i]) {
-                isCritical = true;
-                attackCountHuman[i] = 0; // Reset counter after critical hit
-            }
+// Worker pool
+// A fixed set of Win32 threads that run the tasks of one parallelFor call at a
+// time. The calling thread takes part as well, so a pool of N threads starts
+// N - 1 workers. Tasks are handed out one by one with an atomic counter.
+// parallelFor is not reentrant: a task must not call it on the same pool.
 
-            // Calculate attack power
-            long long int attackPower = (long long int)insanImparatorlugu[i].saldiri * insanImparatorlugu[i].kalanBirimSayisi;
-            if (isCritical) {
-                attackPower = (long long int)(attackPower * 1.5); // Increase by 50%
-                fprintf(logFile, "Round %d: Human unit (%s) lands a SCHEDULED CRITICAL HIT! Attack power increased by 50%% to %lld.\n", round, insanImparatorlugu[i].isim, attackPower);
-            }
+typedef void (*ParallelTask)(void *arg, int index);
 
-            // Hedef Orc birimini se
-            int targetIndex = orkAttackIndex;
-            // Find the next available Orc unit
-            bool targetFound = false;
-            for (int k = 0; k < orkUnitCount; k++) {
-                int currentIndex = (orkAttackIndex + k) % orkUnitCount;
-                if (orkLegionu[currentIndex].kalanBirimSayisi > 0) {
-                    targetIndex = currentIndex;
-                    orkAttackIndex = (currentIndex + 1) % orkUnitCount;
-                    targetFound = true;
-                    break;
-                }
-            }
+typedef struct {
+    HANDLE *threads;
+    int threadCount;          // Worker threads, not counting the caller
+    HANDLE startSemaphore;    // Released once per worker for every job
+    HANDLE doneEvent;         // Set by the last worker to finish a job
+    ParallelTask task;
+    void *arg;
+    LONG taskCount;
+    volatile LONG nextTask;
+    volatile LONG busyWorkers;
+    volatile LONG stopping;
+} WorkerPool;
+
+// Take tasks of the current job until none are left
+static void workerPoolDrain(WorkerPool *pool) {
+    LONG index;
+    while ((index = InterlockedIncrement(&pool->nextTask) - 1) < pool->taskCount) {
+        pool->task(pool->arg, (int)index);
+    }
+}
+
+static DWORD WINAPI workerPoolThread(LPVOID param) {
+    WorkerPool *pool = (WorkerPool *)param;
+    for (;;) {
+        WaitForSingleObject(pool->startSemaphore, INFINITE);
+        if (pool->stopping) break;
+        workerPoolDrain(pool);
+        if (InterlockedDecrement(&pool->busyWorkers) == 0) {
+            SetEvent(pool->doneEvent);
+        }
+    }
+    return 0;
+}
+
+// Wall-clock time in seconds, for timing work spread over several threads
+double wallClockSeconds(void) {
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+// Number of logical processors
+int workerPoolDefaultThreads(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+// Start a pool that runs jobs on 'threadCount' threads, the caller included
+bool workerPoolInit(WorkerPool *pool, int threadCount) {
+    memset(pool, 0, sizeof(*pool));
+    if (threadCount <= 1) return true; // Everything runs on the calling thread
+
+    pool->threads = (HANDLE *)calloc(threadCount - 1, sizeof(HANDLE));
+    pool->startSemaphore = CreateSemaphore(NULL, 0, threadCount, NULL);
+    pool->doneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (pool->threads == NULL || pool->startSemaphore == NULL || pool->doneEvent == NULL) {
+        fprintf(stderr, "Failed to create the worker pool.\n");
+        if (pool->startSemaphore != NULL) CloseHandle(pool->startSemaphore);
+        if (pool->doneEvent != NULL) CloseHandle(pool->doneEvent);
+        free(pool->threads);
+        memset(pool, 0, sizeof(*pool));
+        return false;
+    }
+    for (int i = 0; i < threadCount - 1; i++) {
+        pool->threads[i] = CreateThread(NULL, 0, workerPoolThread, pool, 0, NULL);
+        if (pool->threads[i] == NULL) break;
+        pool->threadCount++;
+    }
+    return true;
+}
+
+void workerPoolDestroy(WorkerPool *pool) {
+    if (pool->threadCount > 0) {
+        pool->stopping = 1;
+        ReleaseSemaphore(pool->startSemaphore, pool->threadCount, NULL);
+        WaitForMultipleObjects(pool->threadCount, pool->threads, TRUE, INFINITE);
+        for (int i = 0; i < pool->threadCount; i++) {
+            CloseHandle(pool->threads[i]);
+        }
+    }
+    if (pool->startSemaphore != NULL) CloseHandle(pool->startSemaphore);
+    if (pool->doneEvent != NULL) CloseHandle(pool->doneEvent);
+    free(pool->threads);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Run task(arg, 0) .. task(arg, taskCount - 1) on the pool and wait for all of
+// them. With a NULL or empty pool the tasks run in order on the calling thread.
+void parallelFor(WorkerPool *pool, int taskCount, ParallelTask task, void *arg) {
+    if (pool == NULL || pool->threadCount == 0 || taskCount <= 1) {
+        for (int i = 0; i < taskCount; i++) {
+            task(arg, i);
+        }
+        return;
+    }
+    pool->task = task;
+    pool->arg = arg;
+    pool->taskCount = taskCount;
+    pool->nextTask = 0;
+    pool->busyWorkers = pool->threadCount;
+    ReleaseSemaphore(pool->startSemaphore, pool->threadCount, NULL);
+    workerPoolDrain(pool);
+    WaitForSingleObject(pool->doneEvent, INFINITE);
+}
+
+// Battle engine
+// All state of one battle lives in a BattleContext, so independent battles
+// can run side by side (e.g. on different threads) without sharing anything.
+
+// Side indices inside BattleContext.sides
+#define SIDE_HUMAN 0
+#define SIDE_ORC 1
+
+// Result of a battle
+typedef enum {
+    BATTLE_ONGOING = 0,
+    BATTLE_HUMANS_WIN,
+    BATTLE_ORCS_WIN,
+    BATTLE_DRAW
+} BattleOutcome;
+
+// How a hit turns damage into dead units
+typedef enum {
+    CASUALTY_ONE_PER_HIT = 0, // Original rule: a lethal hit kills one unit, excess damage is lost
+    CASUALTY_BULK             // A hit kills damage / saglik units and carries the rest into the next unit
+} CasualtyMode;
+
+// Tunable battle parameters
+typedef struct {
+    float fatiguePercentage; // Fatigue percentage
+    int fatigueFrequency;    // Apply fatigue every 'fatigueFrequency' rounds
+    int maxRounds;           // Maximum number of rounds
+    CasualtyMode casualtyMode;
+    bool skipQuietRounds;    // Jump over stretches without fatigue, crits or deaths
+    int decideCheckInterval; // Every N rounds check whether the winner is already certain (0 = never)
+    bool finishAfterDecided; // Keep simulating after the outcome is certain to get exact unit counts
+    bool simultaneousRounds; // Both armies attack from the start-of-round state (see battleSimultaneousRound)
+    bool randomCrits;        // Crits are kritikSans% draws instead of every critThreshold-th attack
+    unsigned long long int seed; // Seed of the crit draws (see battleRandom)
+} BattleOptions;
+
+// Cold per-unit data: only used for logging and drawing, never by the round kernel
+typedef struct {
+    char isim[50];
+    Color color;
+    Texture2D texture;
+    bool hasHeroEffect;
+    bool hasMonsterEffect;
+} BirimBilgisi;
+
+// One army. The combat state is kept as one contiguous array per field
+// (structure of arrays) so the round kernel only touches the hot fields;
+// names, colors and textures live in the 'bilgi' side table.
+typedef struct {
+    char etiket[24];         // Name used in log lines ("Human", "Orc")
+    char cogulEtiket[24];    // Plural name used in log lines ("Humans", "Orcs")
+    int birimSayisi;
+    // Hot combat state, one entry per unit type
+    long long int *kalanBirimSayisi;
+    long long int *pendingDamage; // Scratch space for battleSkipQuietRounds
+    // Scratch space for simultaneous rounds: outgoing hits by attacker rank,
+    // incoming damage and hits by unit type
+    long long int *hitPower;
+    long long int *hitDamage;
+    long long int *incomingDamage;
+    long long int *incomingHits;
+    long long int *unitsLost;
+    int *saldiri;
+    int *savunma;
+    int *saglik;
+    int *maksimumSaglik;
+    int *attackCount;        // Attacks since the last critical hit
+    int *critThreshold;      // Attacks needed for a critical hit
+    int *critChance;         // kritikSans, for random crits
+    int attackIndex;         // Next unit of this army the enemy will try to hit
+    int *aliveIndex;         // Living unit types in index order (simultaneous rounds)
+    int *hitTarget;
+    int *hitCritical;
+    int aliveCount;
+    int firstTarget;         // Position in aliveIndex of the first unit hit this round
+    // Cold side table
+    BirimBilgisi *bilgi;
+    void *storage;           // Single allocation backing all of the arrays above
+} BattleSide;
+
+typedef struct ResultCache ResultCache;
+
+typedef struct {
+    BattleSide sides[2];
+    BattleOptions options;
+    int roundNumber;         // Next round to be played
+    int roundsPlayed;
+    int stepCount;           // battleStep calls, differs from roundsPlayed when rounds are skipped
+    int nextDecideCheck;     // Round after which the next outcome bound check runs
+    int decidedRound;        // Round at which the outcome became certain (0 = not yet)
+    BattleOutcome decidedOutcome;
+    bool stoppedEarly;       // Stopped at decidedRound instead of playing the battle out
+    BattleOutcome outcome;
+    bool byRemainingUnits;   // Outcome decided by unit totals after maxRounds
+    FILE *logFile;           // NULL disables logging
+    WorkerPool *pool;        // Threads for simultaneous rounds (NULL = calling thread only)
+    ResultCache *cache;      // Consulted by battleRunCached and battleRunManyCached (NULL = off)
+    bool fromCache;          // The result was taken from the cache, no rounds were played
+} BattleContext;
+
+// Default options used by the original simulator
+void battleDefaultOptions(BattleOptions *options) {
+    options->fatiguePercentage = 0.10f;
+    options->fatigueFrequency = 5;
+    options->maxRounds = 10000;
+    options->casualtyMode = CASUALTY_ONE_PER_HIT;
+    options->skipQuietRounds = false;
+    options->decideCheckInterval = 0;
+    options->finishAfterDecided = false;
+    options->simultaneousRounds = false;
+    options->randomCrits = false;
+    options->seed = 0;
+}
+
+// Write to the battle log if there is one
+static void battleLog(const BattleContext *ctx, const char *format, ...) {
+    if (ctx->logFile == NULL) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(ctx->logFile, format, args);
+    va_end(args);
+}
+
+// Number of attacks needed for a scheduled critical hit
+int critThresholdFromChance(int kritikSans) {
+    if (kritikSans > 0) {
+        int threshold = (int)(100.0 / kritikSans);
+        return threshold == 0 ? INT_MAX : threshold; // Prevent division by zero
+    }
+    return INT_MAX; // No critical hits
+}
+
+// Allocate the per-field arrays of a side from one block
+static bool battleSideAllocate(BattleSide *side, int birimSayisi) {
+    size_t n = birimSayisi > 0 ? (size_t)birimSayisi : 1;
+    size_t size = n * (7 * sizeof(long long int) + 10 * sizeof(int) + sizeof(BirimBilgisi));
+    char *block = (char *)calloc(1, size);
+    if (block == NULL) return false;
+
+    side->storage = block;
+    side->birimSayisi = birimSayisi;
+    side->kalanBirimSayisi = (long long int *)block; block += n * sizeof(long long int);
+    side->pendingDamage = (long long int *)block;    block += n * sizeof(long long int);
+    side->hitPower = (long long int *)block;         block += n * sizeof(long long int);
+    side->hitDamage = (long long int *)block;        block += n * sizeof(long long int);
+    side->incomingDamage = (long long int *)block;   block += n * sizeof(long long int);
+    side->incomingHits = (long long int *)block;     block += n * sizeof(long long int);
+    side->unitsLost = (long long int *)block;        block += n * sizeof(long long int);
+    side->saldiri = (int *)block;                    block += n * sizeof(int);
+    side->savunma = (int *)block;                    block += n * sizeof(int);
+    side->saglik = (int *)block;                     block += n * sizeof(int);
+    side->maksimumSaglik = (int *)block;             block += n * sizeof(int);
+    side->attackCount = (int *)block;                block += n * sizeof(int);
+    side->critThreshold = (int *)block;              block += n * sizeof(int);
+    side->critChance = (int *)block;                 block += n * sizeof(int);
+    side->aliveIndex = (int *)block;                 block += n * sizeof(int);
+    side->hitTarget = (int *)block;                  block += n * sizeof(int);
+    side->hitCritical = (int *)block;                block += n * sizeof(int);
+    side->bilgi = (BirimBilgisi *)block;
+    return true;
+}
+
+static bool battleSideInit(BattleSide *side, const char *etiket, const char *cogulEtiket, const Birim *birimler, int birimSayisi) {
+    snprintf(side->etiket, sizeof(side->etiket), "%s", etiket);
+    snprintf(side->cogulEtiket, sizeof(side->cogulEtiket), "%s", cogulEtiket);
+    side->attackIndex = 0;
+    if (!battleSideAllocate(side, birimSayisi)) {
+        return false;
+    }
+    for (int i = 0; i < birimSayisi; i++) {
+        side->kalanBirimSayisi[i] = birimler[i].kalanBirimSayisi;
+        side->saldiri[i] = birimler[i].saldiri;
+        side->savunma[i] = birimler[i].savunma;
+        side->saglik[i] = birimler[i].saglik;
+        // Bulk casualties divide by it; a unit type without health still dies per hit
+        side->maksimumSaglik[i] = birimler[i].maksimumSaglik > 0 ? birimler[i].maksimumSaglik : 1;
+        side->critThreshold[i] = critThresholdFromChance(birimler[i].kritikSans);
+        side->critChance[i] = birimler[i].kritikSans;
+        memcpy(side->bilgi[i].isim, birimler[i].isim, sizeof(side->bilgi[i].isim));
+        side->bilgi[i].color = birimler[i].color;
+        side->bilgi[i].texture = birimler[i].texture;
+        side->bilgi[i].hasHeroEffect = birimler[i].hasHeroEffect;
+        side->bilgi[i].hasMonsterEffect = birimler[i].hasMonsterEffect;
+    }
+    return true;
+}
+
+static void battleSideDestroy(BattleSide *side) {
+    free(side->storage);
+    memset(side, 0, sizeof(*side));
+}
+
+void battleDestroy(BattleContext *ctx) {
+    battleSideDestroy(&ctx->sides[SIDE_HUMAN]);
+    battleSideDestroy(&ctx->sides[SIDE_ORC]);
+}
+
+// Copy the live combat state of one side into Birim records (e.g. for drawing);
+// textures and other cold data already in 'birimler' are left alone
+void battleExportState(const BattleContext *ctx, int side, Birim *birimler) {
+    const BattleSide *source = &ctx->sides[side];
+    for (int i = 0; i < source->birimSayisi; i++) {
+        birimler[i].saldiri = source->saldiri[i];
+        birimler[i].savunma = source->savunma[i];
+        birimler[i].saglik = source->saglik[i];
+        birimler[i].maksimumSaglik = source->maksimumSaglik[i];
+        birimler[i].kalanBirimSayisi = source->kalanBirimSayisi[i];
+    }
+}
+
+// Full Birim records of one side without textures, e.g. to draw a battle
+// that was loaded from a checkpoint
+void battleExportUnits(const BattleContext *ctx, int side, Birim *birimler) {
+    const BattleSide *source = &ctx->sides[side];
+    for (int i = 0; i < source->birimSayisi; i++) {
+        memset(&birimler[i], 0, sizeof(birimler[i]));
+        memcpy(birimler[i].isim, source->bilgi[i].isim, sizeof(birimler[i].isim));
+        birimler[i].kritikSans = source->critChance[i];
+        birimler[i].color = source->bilgi[i].color;
+        birimler[i].hasHeroEffect = source->bilgi[i].hasHeroEffect;
+        birimler[i].hasMonsterEffect = source->bilgi[i].hasMonsterEffect;
+    }
+    battleExportState(ctx, side, birimler);
+}
+
+// Make 'dst' an independent copy of 'src', including round number, crit
+// counters and target cursors. The worker pool, if any, is shared.
+bool battleClone(BattleContext *dst, const BattleContext *src) {
+    *dst = *src;
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *from = &src->sides[s];
+        BattleSide *to = &dst->sides[s];
+        to->storage = NULL;
+        if (!battleSideAllocate(to, from->birimSayisi)) {
+            fprintf(stderr, "Memory allocation failed!\n");
+            if (s == 1) battleSideDestroy(&dst->sides[0]);
+            return false;
+        }
+        size_t n = from->birimSayisi;
+        memcpy(to->kalanBirimSayisi, from->kalanBirimSayisi, n * sizeof(long long int));
+        memcpy(to->saldiri, from->saldiri, n * sizeof(int));
+        memcpy(to->savunma, from->savunma, n * sizeof(int));
+        memcpy(to->saglik, from->saglik, n * sizeof(int));
+        memcpy(to->maksimumSaglik, from->maksimumSaglik, n * sizeof(int));
+        memcpy(to->attackCount, from->attackCount, n * sizeof(int));
+        memcpy(to->critThreshold, from->critThreshold, n * sizeof(int));
+        memcpy(to->critChance, from->critChance, n * sizeof(int));
+        memcpy(to->bilgi, from->bilgi, n * sizeof(BirimBilgisi));
+    }
+    return true;
+}
+
+// Set up a battle; the unit arrays are copied, so the caller keeps ownership
+bool battleInit(BattleContext *ctx, const Birim *insanImparatorlugu, int insanUnitCount,
+                const Birim *orkLegionu, int orkUnitCount, const BattleOptions *options, FILE *logFile) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (options != NULL) {
+        ctx->options = *options;
+    } else {
+        battleDefaultOptions(&ctx->options);
+    }
+    ctx->roundNumber = 1;
+    ctx->nextDecideCheck = ctx->options.decideCheckInterval;
+    ctx->outcome = BATTLE_ONGOING;
+    ctx->logFile = logFile;
+
+    if (!battleSideInit(&ctx->sides[SIDE_HUMAN], "Human", "Humans", insanImparatorlugu, insanUnitCount) ||
+        !battleSideInit(&ctx->sides[SIDE_ORC], "Orc", "Orcs", orkLegionu, orkUnitCount)) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        battleDestroy(ctx);
+        return false;
+    }
+    return true;
+}
+
+// Name one side in the log and in reports (battleInit uses "Human" and "Orc")
+void battleSetLabels(BattleContext *ctx, int side, const char *etiket, const char *cogulEtiket) {
+    snprintf(ctx->sides[side].etiket, sizeof(ctx->sides[side].etiket), "%s", etiket);
+    snprintf(ctx->sides[side].cogulEtiket, sizeof(ctx->sides[side].cogulEtiket), "%s", cogulEtiket);
+}
+
+long long int battleTotalUnits(const BattleSide *side) {
+    long long int total = 0;
+    for (int i = 0; i < side->birimSayisi; i++) {
+        total += side->kalanBirimSayisi[i];
+    }
+    return total;
+}
+
+// First living unit at or after 'index' (wrapping around), -1 if none is left
+static int battleNextAlive(const BattleSide *side, int index) {
+    for (int k = 0; k < side->birimSayisi; k++) {
+        int currentIndex = (index + k) % side->birimSayisi;
+        if (side->kalanBirimSayisi[currentIndex] > 0) {
+            return currentIndex;
+        }
+    }
+    return -1;
+}
+
+// Apply 'damage' to unit 't' in bulk: the front unit absorbs what is left of
+// its health, every further maksimumSaglik of damage kills one more unit (at
+// most 'maxLost') and the remainder is carried into the new front unit.
+// Damage beyond the last allowed death is lost. Returns the units lost.
+static long long int battleTakeDamage(BattleSide *defenders, int t, long long int damage, long long int maxLost) {
+    if (damage < defenders->saglik[t]) {
+        defenders->saglik[t] -= (int)damage;
+        return 0;
+    }
+
+    // Count damage as if it started on a full-health unit
+    int maksimumSaglik = defenders->maksimumSaglik[t];
+    long long int effectiveDamage = damage + (maksimumSaglik - defenders->saglik[t]);
+    long long int unitsLost = calculateUnitsLost(effectiveDamage, maksimumSaglik);
+    if (maxLost > defenders->kalanBirimSayisi[t]) {
+        maxLost = defenders->kalanBirimSayisi[t];
+    }
+    if (unitsLost >= maxLost) {
+        unitsLost = maxLost;
+        defenders->saglik[t] = maksimumSaglik;
+    } else {
+        defenders->saglik[t] = maksimumSaglik - (int)(effectiveDamage % maksimumSaglik);
+    }
+    defenders->kalanBirimSayisi[t] -= unitsLost;
+    return unitsLost;
+}
+
+// Apply one hit in CASUALTY_BULK mode
+static void applyBulkCasualties(BattleContext *ctx, BattleSide *defenders, int t, long long int damage) {
+    long long int unitsLost = battleTakeDamage(defenders, t, damage, defenders->kalanBirimSayisi[t]);
+    if (unitsLost > 0) {
+        battleLog(ctx, "%s unit (%s) lost %lld units. Remaining units: %lld\n", defenders->etiket, defenders->bilgi[t].isim, unitsLost, defenders->kalanBirimSayisi[t]);
+    }
+}
+
+// Counter-based random numbers
+// A draw is a pure function of (seed, side, unit, round): every unit attacks
+// at most once per round, so no generator state is carried between draws and
+// results do not depend on the order or the thread the draws are made on.
+
+#define RANDOM_GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+
+// SplitMix64 finalizer
+static inline unsigned long long int randomMix64(unsigned long long int x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Random 64-bit value for one attack of unit 'unit' of side 'side' in 'round'
+unsigned long long int battleRandom(unsigned long long int seed, int side, int unit, int round) {
+    unsigned long long int stream = randomMix64(seed + RANDOM_GOLDEN_GAMMA * ((((unsigned long long int)(unsigned int)unit << 1) | (unsigned int)side) + 1));
+    return randomMix64(stream + RANDOM_GOLDEN_GAMMA * (unsigned int)round);
+}
+
+// Seed of battle 'index' of a family (Monte Carlo replica, batch scenario)
+unsigned long long int battleDeriveSeed(unsigned long long int seed, long long int index) {
+    return randomMix64(seed ^ randomMix64(RANDOM_GOLDEN_GAMMA * (unsigned long long int)(index + 1)));
+}
+
+// Decide whether unit 'i' of side 's' lands a critical hit with this attack
+static bool battleRollCrit(BattleContext *ctx, int s, int i) {
+    BattleSide *attackers = &ctx->sides[s];
+    if (ctx->options.randomCrits) {
+        // Top 32 bits against kritikSans% of 2^32
+        int chance = attackers->critChance[i];
+        if (chance <= 0) return false;
+        if (chance >= 100) return true;
+        return (battleRandom(ctx->options.seed, s, i, ctx->roundNumber) >> 32) < ((unsigned long long int)chance << 32) / 100;
+    }
+    attackers->attackCount[i]++;
+    if (attackers->attackCount[i] >= attackers->critThreshold[i]) {
+        attackers->attackCount[i] = 0; // Reset counter after critical hit
+        return true;
+    }
+    return false;
+}
+
+// Every living unit of 'attackers' hits the next living unit of 'defenders'
+static void battleAttackPhase(BattleContext *ctx, BattleSide *attackers, BattleSide *defenders) {
+    for (int i = 0; i < attackers->birimSayisi; i++) {
+        if (attackers->kalanBirimSayisi[i] <= 0) continue;
+
+        // Check for critical hit
+        bool isCritical = battleRollCrit(ctx, (int)(attackers - ctx->sides), i);
+
+        // Calculate attack power
+        long long int attackPower = (long long int)attackers->saldiri[i] * attackers->kalanBirimSayisi[i];
+        if (isCritical) {
+            attackPower = (long long int)(attackPower * 1.5); // Increase by 50%
+            battleLog(ctx, "Round %d: %s unit (%s) lands a %sCRITICAL HIT! Attack power increased by 50%% to %lld.\n", ctx->roundNumber, attackers->etiket, attackers->bilgi[i].isim, ctx->options.randomCrits ? "" : "SCHEDULED ", attackPower);
+        }
+
+        // Find the next available enemy unit
+        int targetIndex = battleNextAlive(defenders, defenders->attackIndex);
+        if (targetIndex < 0) continue;
+        defenders->attackIndex = (targetIndex + 1) % defenders->birimSayisi;
+
+        // Hasar hesaplama
+        int t = targetIndex;
+        long long int damage = calculateNetDamage(attackPower, (long long int)defenders->savunma[t]);
+
+        // Loglama
+        battleLog(ctx, "%s unit (%s) attacks %s unit (%s) for %lld damage.\n", attackers->etiket, attackers->bilgi[i].isim, defenders->etiket, defenders->bilgi[t].isim, damage);
+
+        if (ctx->options.casualtyMode == CASUALTY_BULK) {
+            applyBulkCasualties(ctx, defenders, t, damage);
+            continue;
+        }
+
+        defenders->saglik[t] -= damage;
+        // Hedef birimin lmesi durumunda
+        if (defenders->saglik[t] <= 0) {
+            defenders->saglik[t] = defenders->maksimumSaglik[t];
+            defenders->kalanBirimSayisi[t]--;
+            battleLog(ctx, "%s unit (%s) has been defeated. Remaining units: %lld\n", defenders->etiket, defenders->bilgi[t].isim, defenders->kalanBirimSayisi[t]);
+        }
+    }
+}
+
+// Simultaneous rounds
+// Both armies attack from the state at the start of the round. Target choice
+// follows the round-robin cursor over the units alive at that point, so the
+// k-th living attacker hits the k-th living defender after the cursor. Each
+// attacker's damage is computed independently, then every defender sums the
+// hits aimed at it and takes them at once: all damage as in CASUALTY_BULK,
+// and with CASUALTY_ONE_PER_HIT at most one death per hit. Units killed in
+// the round still strike back. Both steps are split into fixed chunks that
+// run on ctx->pool; every sum is over integers in a fixed order, so the result
+// does not depend on the number of threads.
 
-            if (targetFound) {
-                // Hasar hesaplama
-                long long int damage = calculateNetDamage(attackPower, (long long int)orkLegionu[targetIndex].savunma);
-                orkLegionu[targetIndex].saglik -= damage;
+// Unit types handled by one parallel task
+#define SIMULTANEOUS_CHUNK 256
+
+typedef struct {
+    BattleContext *ctx;
+    int chunks[2];  // Tasks per side
+} SimultaneousJob;
+
+// Aim step: attacker ranks [chunk * SIMULTANEOUS_CHUNK, ...) of one side
+static void battleSimultaneousAim(void *arg, int task) {
+    SimultaneousJob *job = (SimultaneousJob *)arg;
+    int a = task < job->chunks[0] ? 0 : 1;
+    int chunk = a == 0 ? task : task - job->chunks[0];
+    BattleSide *attackers = &job->ctx->sides[a];
+    const BattleSide *defenders = &job->ctx->sides[1 - a];
+    int end = (chunk + 1) * SIMULTANEOUS_CHUNK;
+    if (end > attackers->aliveCount) end = attackers->aliveCount;
+
+    for (int r = chunk * SIMULTANEOUS_CHUNK; r < end; r++) {
+        int i = attackers->aliveIndex[r];
+        bool isCritical = battleRollCrit(job->ctx, a, i);
+        long long int attackPower = (long long int)attackers->saldiri[i] * attackers->kalanBirimSayisi[i];
+        if (isCritical) {
+            attackPower = (long long int)(attackPower * 1.5);
+        }
+        attackers->hitPower[r] = attackPower;
+        attackers->hitCritical[r] = isCritical;
+        if (defenders->aliveCount == 0) {
+            attackers->hitTarget[r] = -1;
+            continue;
+        }
+        int t = defenders->aliveIndex[(defenders->firstTarget + r) % defenders->aliveCount];
+        attackers->hitTarget[r] = t;
+        attackers->hitDamage[r] = calculateNetDamage(attackPower, (long long int)defenders->savunma[t]);
+    }
+}
+
+// Resolve step: defender positions [chunk * SIMULTANEOUS_CHUNK, ...) of one side
+static void battleSimultaneousResolve(void *arg, int task) {
+    SimultaneousJob *job = (SimultaneousJob *)arg;
+    int d = task < job->chunks[0] ? 0 : 1;
+    int chunk = d == 0 ? task : task - job->chunks[0];
+    BattleSide *defenders = &job->ctx->sides[d];
+    const BattleSide *attackers = &job->ctx->sides[1 - d];
+    int m = defenders->aliveCount;
+    int end = (chunk + 1) * SIMULTANEOUS_CHUNK;
+    if (end > m) end = m;
+
+    for (int p = chunk * SIMULTANEOUS_CHUNK; p < end; p++) {
+        int t = defenders->aliveIndex[p];
+        long long int damage = 0, hits = 0;
+        // Attacker ranks that were aimed at position p, in rank order
+        for (int r = (p - defenders->firstTarget + m) % m; r < attackers->aliveCount; r += m) {
+            damage += attackers->hitDamage[r];
+            hits++;
+        }
+        defenders->incomingDamage[t] = damage;
+        defenders->incomingHits[t] = hits;
+        long long int maxLost = job->ctx->options.casualtyMode == CASUALTY_BULK ? defenders->kalanBirimSayisi[t] : hits;
+        defenders->unitsLost[t] = hits > 0 ? battleTakeDamage(defenders, t, damage, maxLost) : 0;
+    }
+}
+
+// Both attack phases of one round, resolved simultaneously
+static void battleSimultaneousRound(BattleContext *ctx) {
+    SimultaneousJob job;
+    job.ctx = ctx;
+
+    // Living units and the first target of each side, from the round's start state
+    for (int s = 0; s < 2; s++) {
+        BattleSide *side = &ctx->sides[s];
+        int first = battleNextAlive(side, side->attackIndex);
+        side->aliveCount = 0;
+        side->firstTarget = 0;
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (side->kalanBirimSayisi[i] <= 0) continue;
+            if (i == first) side->firstTarget = side->aliveCount;
+            side->aliveIndex[side->aliveCount++] = i;
+        }
+        job.chunks[s] = (side->aliveCount + SIMULTANEOUS_CHUNK - 1) / SIMULTANEOUS_CHUNK;
+    }
+
+    parallelFor(ctx->pool, job.chunks[0] + job.chunks[1], battleSimultaneousAim, &job);
+    parallelFor(ctx->pool, job.chunks[0] + job.chunks[1], battleSimultaneousResolve, &job);
+
+    // Advance the cursors past the last unit hit
+    for (int d = 0; d < 2; d++) {
+        BattleSide *defenders = &ctx->sides[d];
+        int attacks = ctx->sides[1 - d].aliveCount;
+        if (attacks > 0 && defenders->aliveCount > 0) {
+            int last = defenders->aliveIndex[(defenders->firstTarget + attacks - 1) % defenders->aliveCount];
+            defenders->attackIndex = (last + 1) % defenders->birimSayisi;
+        }
+    }
+
+    // Log in a fixed order once the round is resolved
+    if (ctx->logFile == NULL) return;
+    for (int a = 0; a < 2; a++) {
+        const BattleSide *attackers = &ctx->sides[a];
+        const BattleSide *defenders = &ctx->sides[1 - a];
+        for (int r = 0; r < attackers->aliveCount; r++) {
+            const char *isim = attackers->bilgi[attackers->aliveIndex[r]].isim;
+            if (attackers->hitCritical[r]) {
+                battleLog(ctx, "Round %d: %s unit (%s) lands a %sCRITICAL HIT! Attack power increased by 50%% to %lld.\n", ctx->roundNumber, attackers->etiket, isim, ctx->options.randomCrits ? "" : "SCHEDULED ", attackers->hitPower[r]);
+            }
+            if (attackers->hitTarget[r] >= 0) {
+                battleLog(ctx, "%s unit (%s) attacks %s unit (%s) for %lld damage.\n", attackers->etiket, isim, defenders->etiket, defenders->bilgi[attackers->hitTarget[r]].isim, attackers->hitDamage[r]);
+            }
+        }
+    }
+    for (int d = 0; d < 2; d++) {
+        const BattleSide *defenders = &ctx->sides[d];
+        for (int p = 0; p < defenders->aliveCount; p++) {
+            int t = defenders->aliveIndex[p];
+            if (defenders->unitsLost[t] > 0) {
+                battleLog(ctx, "%s unit (%s) lost %lld units. Remaining units: %lld\n", defenders->etiket, defenders->bilgi[t].isim, defenders->unitsLost[t], defenders->kalanBirimSayisi[t]);
+            }
+        }
+    }
+}
+
+// Longest target rotation battleSkipQuietRounds will look for
+#define SKIP_MAX_PERIOD 4096
+
+// True if a fatigue tick would change the stats of any living unit
+// (stats stop changing once they reach the minimum of 1)
+static bool battleFatigueChangesStats(const BattleContext *ctx) {
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (side->kalanBirimSayisi[i] <= 0) continue;
+            int saldiri = side->saldiri[i];
+            int savunma = side->savunma[i];
+            applyFatigueEffect(&saldiri, &savunma, ctx->options.fatiguePercentage);
+            if (saldiri != side->saldiri[i] || savunma != side->savunma[i]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// True if a critical hit by unit 'i' of 'attackers' deals more damage than a
+// normal hit against any living enemy unit
+static bool battleCritChangesDamage(const BattleSide *attackers, int i, const BattleSide *defenders) {
+    long long int attackPower = (long long int)attackers->saldiri[i] * attackers->kalanBirimSayisi[i];
+    long long int critPower = (long long int)(attackPower * 1.5);
+    for (int j = 0; j < defenders->birimSayisi; j++) {
+        if (defenders->kalanBirimSayisi[j] <= 0) continue;
+        if (calculateNetDamage(critPower, defenders->savunma[j]) != calculateNetDamage(attackPower, defenders->savunma[j])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Skip ahead over rounds in which nothing but health changes: no fatigue
+// tick that changes stats, no scheduled crit that changes damage and no
+// unit death. In such a stretch every hit deals the same damage and the
+// target cursors cycle with a fixed period, so whole periods can be applied
+// at once. Returns the number of rounds skipped.
+static int battleSkipQuietRounds(BattleContext *ctx) {
+    int firstRound = ctx->roundNumber;
+    int fatigueFrequency = ctx->options.fatigueFrequency;
+
+    // The last round is always played normally
+    long long int limit = ctx->options.maxRounds - firstRound;
+    // So is the next fatigue round, unless fatigue can no longer change anything
+    if (battleFatigueChangesStats(ctx)) {
+        long long int nextFatigue = (long long int)((firstRound + fatigueFrequency - 1) / fatigueFrequency) * fatigueFrequency;
+        if (nextFatigue - firstRound < limit) {
+            limit = nextFatigue - firstRound;
+        }
+    }
+    // And the next scheduled crit of any living unit whose crit matters
+    // (a random crit can come in any round)
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (side->kalanBirimSayisi[i] <= 0) continue;
+            if (ctx->options.randomCrits) {
+                if (side->critChance[i] > 0 && battleCritChangesDamage(side, i, &ctx->sides[1 - s])) limit = 0;
+                continue;
+            }
+            if (side->critThreshold[i] - side->attackCount[i] - 1 < limit && battleCritChangesDamage(side, i, &ctx->sides[1 - s])) {
+                limit = side->critThreshold[i] - side->attackCount[i] - 1;
+            }
+        }
+    }
+    if (limit < 1) return 0;
+
+    // Dry-run rounds until both target cursors are back where they started
+    int startTarget[2], cursor[2];
+    for (int s = 0; s < 2; s++) {
+        startTarget[s] = battleNextAlive(&ctx->sides[s], ctx->sides[s].attackIndex);
+        if (startTarget[s] < 0) return 0;
+        cursor[s] = ctx->sides[s].attackIndex;
+        memset(ctx->sides[s].pendingDamage, 0, sizeof(long long int) * ctx->sides[s].birimSayisi);
+    }
+    int period = 0;
+    int maxPeriod = limit < SKIP_MAX_PERIOD ? (int)limit : SKIP_MAX_PERIOD;
+    for (int round = 1; round <= maxPeriod && period == 0; round++) {
+        for (int a = 0; a < 2; a++) { // Humans attack first, then orcs
+            const BattleSide *attackers = &ctx->sides[a];
+            BattleSide *defenders = &ctx->sides[1 - a];
+            for (int i = 0; i < attackers->birimSayisi; i++) {
+                if (attackers->kalanBirimSayisi[i] <= 0) continue;
+                int targetIndex = battleNextAlive(defenders, cursor[1 - a]);
+                cursor[1 - a] = (targetIndex + 1) % defenders->birimSayisi;
+                long long int attackPower = (long long int)attackers->saldiri[i] * attackers->kalanBirimSayisi[i];
+                defenders->pendingDamage[targetIndex] += calculateNetDamage(attackPower, (long long int)defenders->savunma[targetIndex]);
+            }
+        }
+        if (battleNextAlive(&ctx->sides[0], cursor[0]) == startTarget[0] &&
+            battleNextAlive(&ctx->sides[1], cursor[1]) == startTarget[1]) {
+            period = round;
+        }
+    }
+    if (period == 0) return 0;
+
+    // Whole periods that leave every unit alive
+    long long int periods = limit / period;
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (side->pendingDamage[i] > 0 && (side->saglik[i] - 1) / side->pendingDamage[i] < periods) {
+                periods = (side->saglik[i] - 1) / side->pendingDamage[i];
+            }
+        }
+    }
+    if (periods < 1) return 0;
+
+    int skipped = (int)(periods * period);
+    for (int s = 0; s < 2; s++) {
+        BattleSide *side = &ctx->sides[s];
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (side->kalanBirimSayisi[i] <= 0) continue;
+            side->saglik[i] -= (int)(periods * side->pendingDamage[i]);
+            // The crit counter cycles through 0 .. critThreshold - 1
+            side->attackCount[i] = (int)(((long long int)side->attackCount[i] + skipped) % side->critThreshold[i]);
+        }
+        side->attackIndex = cursor[s];
+    }
+
+    battleLog(ctx, "\n--- Rounds %d-%d skipped: no stat changes, effective critical hits or deaths ---\n", firstRound, firstRound + skipped - 1);
+    ctx->roundsPlayed = firstRound + skipped - 1;
+    ctx->roundNumber += skipped;
+    return skipped;
+}
+
+// Upper bound on the damage 'side' can still deal from round 'fromRound' to
+// maxRounds: every living unit keeps its current count, lands a critical hit
+// every round and faces no defense, while its attack follows the fatigue schedule
+static double battleDamageBound(const BattleContext *ctx, const BattleSide *side, int fromRound) {
+    int fatigueFrequency = ctx->options.fatigueFrequency;
+    int maxRounds = ctx->options.maxRounds;
+    double bound = 0.0;
+    for (int i = 0; i < side->birimSayisi; i++) {
+        if (side->kalanBirimSayisi[i] <= 0) continue;
+        int saldiri = side->saldiri[i];
+        int savunma = side->savunma[i];
+        double attackRounds = 0.0; // Sum of saldiri over the remaining rounds
+        int round = fromRound;
+        while (round <= maxRounds) {
+            if (round % fatigueFrequency == 0) {
+                applyFatigueEffect(&saldiri, &savunma, ctx->options.fatiguePercentage);
+            }
+            int segmentEnd = (round / fatigueFrequency + 1) * fatigueFrequency - 1;
+            if (saldiri <= 1 || segmentEnd > maxRounds) {
+                segmentEnd = maxRounds; // Attack stays at the minimum from here on
+            }
+            attackRounds += (double)(segmentEnd - round + 1) * saldiri;
+            round = segmentEnd + 1;
+        }
+        bound += attackRounds * (double)side->kalanBirimSayisi[i] * 1.5;
+    }
+    return bound;
+}
+
+// Check whether 'winner' is certain to beat 'loser' from the current state on:
+// even the loser's best-case damage cannot kill enough of the winner to give
+// the loser the larger army, either by elimination or by unit totals at maxRounds
+static bool battleOutcomeCertain(const BattleContext *ctx, const BattleSide *winner, const BattleSide *loser) {
+    int remainingRounds = ctx->options.maxRounds - ctx->roundNumber + 1;
+    double damageBound = battleDamageBound(ctx, loser, ctx->roundNumber);
+
+    // Each death costs at least the target's current health (first death of a
+    // unit type) or its full health (every later death)
+    int aliveTypes = 0;
+    int minHealth = INT_MAX;
+    for (int i = 0; i < winner->birimSayisi; i++) {
+        if (winner->kalanBirimSayisi[i] <= 0) continue;
+        aliveTypes++;
+        if (winner->maksimumSaglik[i] < minHealth) minHealth = winner->maksimumSaglik[i];
+    }
+    if (aliveTypes == 0 || minHealth <= 0) return false;
+    double deathsBound = aliveTypes + damageBound / minHealth;
+
+    // With one death per hit the loser cannot kill more units than it has hits left
+    if (ctx->options.casualtyMode == CASUALTY_ONE_PER_HIT) {
+        int attackingTypes = 0;
+        for (int i = 0; i < loser->birimSayisi; i++) {
+            if (loser->kalanBirimSayisi[i] > 0) attackingTypes++;
+        }
+        double hitsBound = (double)attackingTypes * remainingRounds;
+        if (hitsBound < deathsBound) deathsBound = hitsBound;
+    }
+
+    return (double)battleTotalUnits(winner) - deathsBound > (double)battleTotalUnits(loser);
+}
+
+// Run the outcome bound check when it is due
+static void battleCheckDecided(BattleContext *ctx) {
+    if (ctx->options.decideCheckInterval <= 0 || ctx->decidedRound > 0 ||
+        ctx->outcome != BATTLE_ONGOING || ctx->roundsPlayed < ctx->nextDecideCheck) {
+        return;
+    }
+    while (ctx->nextDecideCheck <= ctx->roundsPlayed) {
+        ctx->nextDecideCheck += ctx->options.decideCheckInterval;
+    }
+
+    if (battleOutcomeCertain(ctx, &ctx->sides[SIDE_HUMAN], &ctx->sides[SIDE_ORC])) {
+        ctx->decidedOutcome = BATTLE_HUMANS_WIN;
+    } else if (battleOutcomeCertain(ctx, &ctx->sides[SIDE_ORC], &ctx->sides[SIDE_HUMAN])) {
+        ctx->decidedOutcome = BATTLE_ORCS_WIN;
+    } else {
+        return;
+    }
+    ctx->decidedRound = ctx->roundsPlayed;
+    battleLog(ctx, "\nOutcome decided at round %d: %s win.\n", ctx->decidedRound, ctx->sides[ctx->decidedOutcome == BATTLE_HUMANS_WIN ? SIDE_HUMAN : SIDE_ORC].cogulEtiket);
+
+    if (!ctx->options.finishAfterDecided) {
+        ctx->outcome = ctx->decidedOutcome;
+        ctx->stoppedEarly = true;
+    }
+}
+
+// Play one round; returns false once the battle is over
+bool battleStep(BattleContext *ctx) {
+    if (ctx->outcome != BATTLE_ONGOING) return false;
+    ctx->stepCount++;
+
+    // A skipped stretch counts as one step; the next event round is played normally
+    if (ctx->options.skipQuietRounds && battleSkipQuietRounds(ctx) > 0) {
+        battleCheckDecided(ctx);
+        return ctx->outcome == BATTLE_ONGOING;
+    }
+
+    BattleSide *humans = &ctx->sides[SIDE_HUMAN];
+    BattleSide *orcs = &ctx->sides[SIDE_ORC];
+    int roundNumber = ctx->roundNumber;
+
+    // Log and simulate the battle round
+    battleLog(ctx, "\n--- Round %d ---\n", roundNumber);
+    ctx->roundsPlayed = roundNumber;
+
+    // Apply fatigue every 'fatigueFrequency' rounds
+    if (roundNumber % ctx->options.fatigueFrequency == 0) {
+        for (int s = 0; s < 2; s++) {
+            for (int i = 0; i < ctx->sides[s].birimSayisi; i++) {
+                applyFatigueEffect(&ctx->sides[s].saldiri[i], &ctx->sides[s].savunma[i], ctx->options.fatiguePercentage);
+            }
+        }
+        battleLog(ctx, "Yorgunluk devreye girdi: Tur %d, birimlerin saldr ve savunma gleri %%10 azald.\n", roundNumber);
+    }
+
+    if (ctx->options.simultaneousRounds) {
+        battleSimultaneousRound(ctx);
+    } else {
+        // HUMAN ATTACK
+        battleAttackPhase(ctx, humans, orcs);
+        // ORC ATTACK
+        battleAttackPhase(ctx, orcs, humans);
+    }
+
+    // Mevcut durumu logla
+    battleLog(ctx, "Status after Round %d:\n", roundNumber);
+    for (int s = 0; s < 2; s++) {
+        battleLog(ctx, "%s:\n", ctx->sides[s].cogulEtiket);
+        for (int i = 0; i < ctx->sides[s].birimSayisi; i++) {
+            battleLog(ctx, " - %s: %lld units remaining, Health per unit: %d\n", ctx->sides[s].bilgi[i].isim, ctx->sides[s].kalanBirimSayisi[i], ctx->sides[s].saglik[i]);
+        }
+    }
+    battleLog(ctx, "----------------------------------------\n");
+
+    // Check if battle has ended
+    bool insanKaybetti = battleTotalUnits(humans) == 0;
+    bool orkKaybetti = battleTotalUnits(orcs) == 0;
+    if (insanKaybetti || orkKaybetti) {
+        // Battle has ended, determine winner
+        if (insanKaybetti && orkKaybetti) {
+            battleLog(ctx, "\nBattle ended on round %d.\nIt's a draw!\n", roundNumber);
+            ctx->outcome = BATTLE_DRAW;
+        } else if (insanKaybetti) {
+            battleLog(ctx, "\nBattle ended on round %d.\n%s win!\n", roundNumber, orcs->cogulEtiket);
+            ctx->outcome = BATTLE_ORCS_WIN;
+        } else {
+            battleLog(ctx, "\nBattle ended on round %d.\n%s win!\n", roundNumber, humans->cogulEtiket);
+            ctx->outcome = BATTLE_HUMANS_WIN;
+        }
+    }
+
+    // Check for maximum rounds to prevent infinite loops
+    if (roundNumber >= ctx->options.maxRounds) {
+        ctx->byRemainingUnits = ctx->outcome == BATTLE_ONGOING;
+        // Determine the winner based on total remaining units
+        long long int totalHumanUnits = battleTotalUnits(humans);
+        long long int totalOrcUnits = battleTotalUnits(orcs);
+        if (totalHumanUnits > totalOrcUnits) {
+            battleLog(ctx, "\nBattle ended after %d rounds.\n%s win by remaining units!\n", roundNumber, humans->cogulEtiket);
+            ctx->outcome = BATTLE_HUMANS_WIN;
+        } else if (totalOrcUnits > totalHumanUnits) {
+            battleLog(ctx, "\nBattle ended after %d rounds.\n%s win by remaining units!\n", roundNumber, orcs->cogulEtiket);
+            ctx->outcome = BATTLE_ORCS_WIN;
+        } else {
+            battleLog(ctx, "\nBattle ended in a draw after %d rounds.\n", roundNumber);
+            ctx->outcome = BATTLE_DRAW;
+        }
+    }
+
+    ctx->roundNumber++;
+    battleCheckDecided(ctx);
+    return ctx->outcome == BATTLE_ONGOING;
+}
+
+// Play rounds until the battle is decided
+BattleOutcome battleRun(BattleContext *ctx) {
+    while (battleStep(ctx)) {
+    }
+    return ctx->outcome;
+}
+
+const char *battleOutcomeName(BattleOutcome outcome) {
+    switch (outcome) {
+        case BATTLE_HUMANS_WIN: return "Humans";
+        case BATTLE_ORCS_WIN: return "Orcs";
+        case BATTLE_DRAW: return "Draw";
+        default: return "Ongoing";
+    }
+}
+
+// Winner of a battle by the plural label of its side, or "Draw" / "Ongoing"
+const char *battleWinnerName(const BattleContext *ctx) {
+    if (ctx->outcome == BATTLE_HUMANS_WIN) return ctx->sides[SIDE_HUMAN].cogulEtiket;
+    if (ctx->outcome == BATTLE_ORCS_WIN) return ctx->sides[SIDE_ORC].cogulEtiket;
+    return battleOutcomeName(ctx->outcome);
+}
+
+
+// Scale every unit count of one side, keeping at least one unit of each type
+// that had any (used to derive families of battles from one scenario)
+void battleScaleCounts(BattleContext *ctx, int side, double scale) {
+    BattleSide *target = &ctx->sides[side];
+    for (int i = 0; i < target->birimSayisi; i++) {
+        long long int count = target->kalanBirimSayisi[i];
+        long long int scaled = (long long int)llround(count * scale);
+        target->kalanBirimSayisi[i] = (count > 0 && scaled < 1) ? 1 : scaled;
+    }
+}
+
+// Checkpoints
+// The complete state of a battle (options, round counters, every unit's
+// counts and current stats, crit counters and target cursors) as a compact
+// binary image. Fatigue lives in the stats and the round number, so nothing
+// else is needed to continue exactly where the image was taken. Values are
+// stored in the machine's own byte order: images are meant to be read back by
+// the same build, e.g. to resume after a crash or to fork what-if runs with
+// other options. Within one process battleClone does the same in memory.
+
+#define CHECKPOINT_MAGIC 0x31504353u     // "SCP1"
+#define CHECKPOINT_VERSION 2
+
+typedef struct {
+    unsigned char *data;     // NULL while only measuring the size
+    size_t size;
+    size_t offset;
+    bool failed;             // Ran past the end while reading
+} CheckpointBuffer;
+
+static void checkpointPut(CheckpointBuffer *buffer, const void *value, size_t size) {
+    if (buffer->data != NULL) memcpy(buffer->data + buffer->offset, value, size);
+    buffer->offset += size;
+}
+
+static void checkpointGet(CheckpointBuffer *buffer, void *value, size_t size) {
+    if (buffer->failed || size > buffer->size - buffer->offset) {
+        buffer->failed = true;
+        memset(value, 0, size);
+        return;
+    }
+    memcpy(value, buffer->data + buffer->offset, size);
+    buffer->offset += size;
+}
+
+static void checkpointPutInt(CheckpointBuffer *buffer, int value) {
+    checkpointPut(buffer, &value, sizeof(value));
+}
+
+static int checkpointGetInt(CheckpointBuffer *buffer) {
+    int value;
+    checkpointGet(buffer, &value, sizeof(value));
+    return value;
+}
+
+// Write (or, with buffer->data == NULL, measure) the image of 'ctx'
+static void battleCheckpointEncode(const BattleContext *ctx, CheckpointBuffer *buffer) {
+    const BattleOptions *options = &ctx->options;
+    checkpointPutInt(buffer, (int)CHECKPOINT_MAGIC);
+    checkpointPutInt(buffer, CHECKPOINT_VERSION);
+    checkpointPut(buffer, &options->fatiguePercentage, sizeof(options->fatiguePercentage));
+    checkpointPutInt(buffer, options->fatigueFrequency);
+    checkpointPutInt(buffer, options->maxRounds);
+    checkpointPutInt(buffer, options->casualtyMode);
+    checkpointPutInt(buffer, options->skipQuietRounds);
+    checkpointPutInt(buffer, options->decideCheckInterval);
+    checkpointPutInt(buffer, options->finishAfterDecided);
+    checkpointPutInt(buffer, options->simultaneousRounds);
+    checkpointPutInt(buffer, options->randomCrits);
+    checkpointPut(buffer, &options->seed, sizeof(options->seed));
+    checkpointPutInt(buffer, ctx->roundNumber);
+    checkpointPutInt(buffer, ctx->roundsPlayed);
+    checkpointPutInt(buffer, ctx->stepCount);
+    checkpointPutInt(buffer, ctx->nextDecideCheck);
+    checkpointPutInt(buffer, ctx->decidedRound);
+    checkpointPutInt(buffer, ctx->decidedOutcome);
+    checkpointPutInt(buffer, ctx->stoppedEarly);
+    checkpointPutInt(buffer, ctx->outcome);
+    checkpointPutInt(buffer, ctx->byRemainingUnits);
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        size_t n = side->birimSayisi;
+        checkpointPutInt(buffer, side->birimSayisi);
+        checkpointPutInt(buffer, side->attackIndex);
+        checkpointPut(buffer, side->etiket, sizeof(side->etiket));
+        checkpointPut(buffer, side->cogulEtiket, sizeof(side->cogulEtiket));
+        checkpointPut(buffer, side->kalanBirimSayisi, n * sizeof(long long int));
+        checkpointPut(buffer, side->saldiri, n * sizeof(int));
+        checkpointPut(buffer, side->savunma, n * sizeof(int));
+        checkpointPut(buffer, side->saglik, n * sizeof(int));
+        checkpointPut(buffer, side->maksimumSaglik, n * sizeof(int));
+        checkpointPut(buffer, side->attackCount, n * sizeof(int));
+        checkpointPut(buffer, side->critThreshold, n * sizeof(int));
+        checkpointPut(buffer, side->critChance, n * sizeof(int));
+        for (size_t i = 0; i < n; i++) {
+            const BirimBilgisi *bilgi = &side->bilgi[i];
+            unsigned char flags[6] = { bilgi->color.r, bilgi->color.g, bilgi->color.b, bilgi->color.a,
+                                       bilgi->hasHeroEffect, bilgi->hasMonsterEffect };
+            checkpointPut(buffer, bilgi->isim, sizeof(bilgi->isim));
+            checkpointPut(buffer, flags, sizeof(flags));
+        }
+    }
+}
+
+// Bytes needed for the image of 'ctx'
+size_t battleCheckpointSize(const BattleContext *ctx) {
+    CheckpointBuffer buffer = { NULL, 0, 0, false };
+    battleCheckpointEncode(ctx, &buffer);
+    return buffer.offset;
+}
+
+// Store the image of 'ctx' in 'data'; returns its size, or 0 if 'size' is too small
+size_t battleSaveCheckpoint(const BattleContext *ctx, unsigned char *data, size_t size) {
+    size_t needed = battleCheckpointSize(ctx);
+    if (needed > size) return 0;
+    CheckpointBuffer buffer = { data, size, 0, false };
+    battleCheckpointEncode(ctx, &buffer);
+    return needed;
+}
+
+// Rebuild a battle from an image. 'ctx' is initialized here (free it with
+// battleDestroy); log file and worker pool are not part of the image.
+bool battleLoadCheckpoint(BattleContext *ctx, const unsigned char *data, size_t size, FILE *logFile) {
+    CheckpointBuffer buffer = { (unsigned char *)data, size, 0, false };
+    memset(ctx, 0, sizeof(*ctx));
+    if (checkpointGetInt(&buffer) != (int)CHECKPOINT_MAGIC || checkpointGetInt(&buffer) != CHECKPOINT_VERSION) {
+        return false;
+    }
+    BattleOptions *options = &ctx->options;
+    checkpointGet(&buffer, &options->fatiguePercentage, sizeof(options->fatiguePercentage));
+    options->fatigueFrequency = checkpointGetInt(&buffer);
+    options->maxRounds = checkpointGetInt(&buffer);
+    options->casualtyMode = (CasualtyMode)checkpointGetInt(&buffer);
+    options->skipQuietRounds = checkpointGetInt(&buffer) != 0;
+    options->decideCheckInterval = checkpointGetInt(&buffer);
+    options->finishAfterDecided = checkpointGetInt(&buffer) != 0;
+    options->simultaneousRounds = checkpointGetInt(&buffer) != 0;
+    options->randomCrits = checkpointGetInt(&buffer) != 0;
+    checkpointGet(&buffer, &options->seed, sizeof(options->seed));
+    ctx->roundNumber = checkpointGetInt(&buffer);
+    ctx->roundsPlayed = checkpointGetInt(&buffer);
+    ctx->stepCount = checkpointGetInt(&buffer);
+    ctx->nextDecideCheck = checkpointGetInt(&buffer);
+    ctx->decidedRound = checkpointGetInt(&buffer);
+    ctx->decidedOutcome = (BattleOutcome)checkpointGetInt(&buffer);
+    ctx->stoppedEarly = checkpointGetInt(&buffer) != 0;
+    ctx->outcome = (BattleOutcome)checkpointGetInt(&buffer);
+    ctx->byRemainingUnits = checkpointGetInt(&buffer) != 0;
+    ctx->logFile = logFile;
+    if (options->fatigueFrequency <= 0) {
+        return false;
+    }
+
+    for (int s = 0; s < 2 && !buffer.failed; s++) {
+        BattleSide *side = &ctx->sides[s];
+        int birimSayisi = checkpointGetInt(&buffer);
+        int attackIndex = checkpointGetInt(&buffer);
+        // Each unit takes at least 90 bytes, which bounds a sane count
+        if (birimSayisi < 0 || (size_t)birimSayisi > (size - buffer.offset) / 90 || !battleSideAllocate(side, birimSayisi)) {
+            buffer.failed = true;
+            break;
+        }
+        size_t n = birimSayisi;
+        checkpointGet(&buffer, side->etiket, sizeof(side->etiket));
+        checkpointGet(&buffer, side->cogulEtiket, sizeof(side->cogulEtiket));
+        side->etiket[sizeof(side->etiket) - 1] = '\0';
+        side->cogulEtiket[sizeof(side->cogulEtiket) - 1] = '\0';
+        side->attackIndex = attackIndex;
+        checkpointGet(&buffer, side->kalanBirimSayisi, n * sizeof(long long int));
+        checkpointGet(&buffer, side->saldiri, n * sizeof(int));
+        checkpointGet(&buffer, side->savunma, n * sizeof(int));
+        checkpointGet(&buffer, side->saglik, n * sizeof(int));
+        checkpointGet(&buffer, side->maksimumSaglik, n * sizeof(int));
+        checkpointGet(&buffer, side->attackCount, n * sizeof(int));
+        checkpointGet(&buffer, side->critThreshold, n * sizeof(int));
+        checkpointGet(&buffer, side->critChance, n * sizeof(int));
+        for (size_t i = 0; i < n && !buffer.failed; i++) {
+            // Bulk casualties and the crit schedule divide by these
+            if (side->maksimumSaglik[i] <= 0 || side->critThreshold[i] <= 0) buffer.failed = true;
+        }
+        for (size_t i = 0; i < n; i++) {
+            BirimBilgisi *bilgi = &side->bilgi[i];
+            unsigned char flags[6];
+            checkpointGet(&buffer, bilgi->isim, sizeof(bilgi->isim));
+            checkpointGet(&buffer, flags, sizeof(flags));
+            bilgi->isim[sizeof(bilgi->isim) - 1] = '\0';
+            bilgi->color = (Color){ flags[0], flags[1], flags[2], flags[3] };
+            bilgi->hasHeroEffect = flags[4] != 0;
+            bilgi->hasMonsterEffect = flags[5] != 0;
+        }
+        if (n > 0 && (attackIndex < 0 || (size_t)attackIndex >= n)) {
+            buffer.failed = true;
+        }
+    }
+    if (buffer.failed || buffer.offset != size) {
+        battleDestroy(ctx);
+        return false;
+    }
+    return true;
+}
+
+// Write the image of 'ctx' to 'path' (through a temporary file, so a crash
+// while writing keeps the previous checkpoint)
+bool battleWriteCheckpoint(const BattleContext *ctx, const char *path) {
+    size_t size = battleCheckpointSize(ctx);
+    unsigned char *data = (unsigned char *)malloc(size);
+    if (data == NULL) return false;
+    battleSaveCheckpoint(ctx, data, size);
+
+    char temporary[1024];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *file = fopen(temporary, "wb");
+    bool ok = file != NULL;
+    if (ok) {
+        ok = fwrite(data, size, 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+        if (ok) {
+            remove(path);
+            ok = rename(temporary, path) == 0;
+        }
+    }
+    free(data);
+    if (!ok) fprintf(stderr, "Failed to write checkpoint %s\n", path);
+    return ok;
+}
+
+// Load a battle written by battleWriteCheckpoint
+bool battleReadCheckpoint(BattleContext *ctx, const char *path, FILE *logFile) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open checkpoint %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char *data = size > 0 ? (unsigned char *)malloc(size) : NULL;
+    bool ok = data != NULL && fread(data, size, 1, file) == 1 && battleLoadCheckpoint(ctx, data, size, logFile);
+    free(data);
+    fclose(file);
+    if (!ok) fprintf(stderr, "Checkpoint %s is damaged or from another version\n", path);
+    return ok;
+}
+
+// Use the rules in 'options' from the current round on (forking a what-if run
+// from a checkpoint). Progress, crit counters and the decided state are kept.
+void battleChangeOptions(BattleContext *ctx, const BattleOptions *options) {
+    ctx->options = *options;
+    ctx->nextDecideCheck = options->decideCheckInterval > 0 ? ctx->roundsPlayed + options->decideCheckInterval : 0;
+}
+
+// Keyframes
+// A run can record its state every 'interval' rounds. The next run of the
+// same armies compares its rules with the recorded ones, finds the first
+// round the change can affect (battleFirstDifferentRound) and continues
+// from the last keyframe before that round, so tuning a late-acting option
+// such as the fatigue frequency or the round limit does not replay the
+// shared prefix. Keyframes are checkpoint images (see battleSaveCheckpoint).
+
+#define KEYFRAME_MAGIC 0x31464B53u       // "SKF1"
+
+typedef struct {
+    int interval;            // Rounds between keyframes
+    int nextRound;           // Round after which the next keyframe is taken
+    unsigned char *start;    // Initial state and rules of the recorded run
+    size_t startSize;
+    int count;
+    int capacity;
+    int *rounds;             // Rounds played when each keyframe was taken
+    unsigned char **images;
+    size_t *sizes;
+} KeyframeStore;
+
+// First round whose play can differ between the rules 'a' and 'b' (INT_MAX
+// if none). Only fatigue and the round limit act late; any other difference
+// changes the battle from round 1.
+int battleFirstDifferentRound(const BattleOptions *a, const BattleOptions *b) {
+    if (a->casualtyMode != b->casualtyMode || a->skipQuietRounds != b->skipQuietRounds ||
+        a->decideCheckInterval != b->decideCheckInterval || a->finishAfterDecided != b->finishAfterDecided ||
+        a->simultaneousRounds != b->simultaneousRounds || a->randomCrits != b->randomCrits ||
+        (a->randomCrits && a->seed != b->seed)) {
+        return 1;
+    }
+    int round = INT_MAX;
+    // Fatigue first differs on the first round where it hits in one run only,
+    // or on the first fatigue round if only its strength changed
+    if (a->fatigueFrequency != b->fatigueFrequency) {
+        round = a->fatigueFrequency < b->fatigueFrequency ? a->fatigueFrequency : b->fatigueFrequency;
+    } else if (a->fatiguePercentage != b->fatiguePercentage) {
+        round = a->fatigueFrequency;
+    }
+    if (a->maxRounds != b->maxRounds) {
+        int limit = a->maxRounds < b->maxRounds ? a->maxRounds : b->maxRounds;
+        if (limit < round) round = limit;
+    }
+    // The outcome bound looks ahead with the fatigue and round limit, so a
+    // check may decide differently as soon as it runs
+    if (round != INT_MAX && a->decideCheckInterval > 0 && a->decideCheckInterval < round) {
+        round = a->decideCheckInterval;
+    }
+    return round < 1 ? 1 : round;
+}
+
+void keyframeStoreInit(KeyframeStore *store, int interval) {
+    memset(store, 0, sizeof(*store));
+    store->interval = interval > 0 ? interval : 1;
+    store->nextRound = store->interval;
+}
+
+// Drop the keyframes from index 'first' on
+static void keyframeStoreTruncate(KeyframeStore *store, int first) {
+    for (int k = first; k < store->count; k++) {
+        free(store->images[k]);
+    }
+    if (first < store->count) store->count = first;
+}
+
+void keyframeStoreFree(KeyframeStore *store) {
+    keyframeStoreTruncate(store, 0);
+    free(store->start);
+    free(store->rounds);
+    free(store->images);
+    free(store->sizes);
+    memset(store, 0, sizeof(*store));
+}
+
+// Take ownership of 'image' as the keyframe after 'round'
+static bool keyframeStoreAppend(KeyframeStore *store, int round, unsigned char *image, size_t size) {
+    if (store->count == store->capacity) {
+        int capacity = store->capacity > 0 ? store->capacity * 2 : 64;
+        int *rounds = (int *)realloc(store->rounds, capacity * sizeof(int));
+        if (rounds != NULL) store->rounds = rounds;
+        unsigned char **images = (unsigned char **)realloc(store->images, capacity * sizeof(unsigned char *));
+        if (images != NULL) store->images = images;
+        size_t *sizes = (size_t *)realloc(store->sizes, capacity * sizeof(size_t));
+        if (sizes != NULL) store->sizes = sizes;
+        if (rounds == NULL || images == NULL || sizes == NULL) {
+            free(image);
+            return false;
+        }
+        store->capacity = capacity;
+    }
+    store->rounds[store->count] = round;
+    store->images[store->count] = image;
+    store->sizes[store->count] = size;
+    store->count++;
+    return true;
+}
+
+// Checkpoint image of 'ctx' in a new allocation
+static unsigned char *keyframeImage(const BattleContext *ctx, size_t *size) {
+    *size = battleCheckpointSize(ctx);
+    unsigned char *image = (unsigned char *)malloc(*size);
+    if (image != NULL) battleSaveCheckpoint(ctx, image, *size);
+    return image;
+}
+
+// Load the keyframes kept at 'path' (a missing file gives an empty store)
+bool keyframeStoreLoad(KeyframeStore *store, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return true;
+    unsigned int header[4];
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == KEYFRAME_MAGIC && header[1] == CHECKPOINT_VERSION;
+    if (ok) {
+        store->startSize = header[3];
+        store->start = (unsigned char *)malloc(store->startSize);
+        ok = store->start != NULL && fread(store->start, store->startSize, 1, file) == 1;
+    }
+    for (unsigned int k = 0; ok && k < header[2]; k++) {
+        unsigned int entry[2];
+        ok = fread(entry, sizeof(entry), 1, file) == 1;
+        unsigned char *image = ok ? (unsigned char *)malloc(entry[1]) : NULL;
+        ok = image != NULL && fread(image, entry[1], 1, file) == 1;
+        if (!ok) {
+            free(image);
+        } else {
+            ok = keyframeStoreAppend(store, (int)entry[0], image, entry[1]);
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Ignoring keyframes in %s: damaged or from another version\n", path);
+        int interval = store->interval;
+        keyframeStoreFree(store);
+        keyframeStoreInit(store, interval);
+    }
+    return ok;
+}
+
+// Write the keyframes to 'path' (through a temporary file)
+bool keyframeStoreSave(const KeyframeStore *store, const char *path) {
+    char temporary[1024];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *file = fopen(temporary, "wb");
+    bool ok = file != NULL && store->start != NULL;
+    if (file != NULL) {
+        unsigned int header[4] = { KEYFRAME_MAGIC, CHECKPOINT_VERSION, (unsigned int)store->count, (unsigned int)store->startSize };
+        ok = ok && fwrite(header, sizeof(header), 1, file) == 1 && fwrite(store->start, store->startSize, 1, file) == 1;
+        for (int k = 0; ok && k < store->count; k++) {
+            unsigned int entry[2] = { (unsigned int)store->rounds[k], (unsigned int)store->sizes[k] };
+            ok = fwrite(entry, sizeof(entry), 1, file) == 1 && fwrite(store->images[k], store->sizes[k], 1, file) == 1;
+        }
+        ok = fclose(file) == 0 && ok;
+        if (ok) {
+            remove(path);
+            ok = rename(temporary, path) == 0;
+        }
+    }
+    if (!ok) fprintf(stderr, "Failed to write keyframes %s\n", path);
+    return ok;
+}
+
+// Move the freshly initialized battle 'ctx' to the last keyframe its rules
+// share with the recorded run and make the store describe this run from
+// there on. Returns the rounds skipped (0 = starts from round 1).
+int keyframeStoreRestore(KeyframeStore *store, BattleContext *ctx) {
+    int round = 1;
+    size_t startSize;
+    unsigned char *start = keyframeImage(ctx, &startSize);
+    if (start == NULL) return 0;
+
+    // Same armies: the initial image matches once the recorded rules are put in
+    BattleContext recorded;
+    if (store->start != NULL && battleLoadCheckpoint(&recorded, store->start, store->startSize, NULL)) {
+        BattleContext probe = *ctx;
+        probe.options = recorded.options;
+        size_t probeSize;
+        unsigned char *image = keyframeImage(&probe, &probeSize);
+        if (image != NULL && probeSize == store->startSize && memcmp(image, store->start, probeSize) == 0) {
+            round = battleFirstDifferentRound(&recorded.options, &ctx->options);
+        }
+        free(image);
+        battleDestroy(&recorded);
+    }
+    free(store->start);
+    store->start = start;
+    store->startSize = startSize;
+
+    int keep = 0;
+    while (keep < store->count && store->rounds[keep] < round) {
+        keep++;
+    }
+    keyframeStoreTruncate(store, keep);
+    BattleContext resumed;
+    if (keep == 0 || !battleLoadCheckpoint(&resumed, store->images[keep - 1], store->sizes[keep - 1], ctx->logFile)) {
+        keyframeStoreTruncate(store, 0);
+        store->nextRound = store->interval;
+        return 0;
+    }
+    resumed.options = ctx->options;
+    resumed.pool = ctx->pool;
+    resumed.cache = ctx->cache;
+    battleDestroy(ctx);
+    *ctx = resumed;
+    store->nextRound = ctx->roundsPlayed + store->interval;
+    return ctx->roundsPlayed;
+}
+
+// Take a keyframe of 'ctx' if one is due or the battle has just ended (NULL store = off)
+void keyframeStoreRecord(KeyframeStore *store, const BattleContext *ctx) {
+    if (store == NULL || (ctx->outcome == BATTLE_ONGOING && ctx->roundsPlayed < store->nextRound)) return;
+    if (store->count > 0 && store->rounds[store->count - 1] == ctx->roundsPlayed) return;
+    size_t size;
+    unsigned char *image = keyframeImage(ctx, &size);
+    if (image != NULL) keyframeStoreAppend(store, ctx->roundsPlayed, image, size);
+    store->nextRound = ctx->roundsPlayed + store->interval;
+}
+
+// Result cache
+// The result of a battle depends only on its effective state: the post-effect
+// stats and counts of every unit, crit thresholds (or chances and seed),
+// target cursors, round number and the options that change the rules. That
+// state is hashed into a 128-bit key, so scenarios that reach the same stats
+// by different routes (e.g. other hero names) share an entry. Entries keep
+// the final counts and stats, are used only for battles without a log and
+// are kept in a file between runs. When the cache grows past its limit the
+// least recently used eighth is dropped. All calls may come from several
+// threads at once.
+
+#define RESULT_CACHE_MAGIC 0x31435253u   // "SRC1"
+#define RESULT_CACHE_VERSION 1           // Bump when the engine's rules change
+
+typedef struct {
+    unsigned long long int key[2];
+    unsigned long long int lastUsed;
+    int outcome;
+    int byRemainingUnits;
+    int roundsPlayed;
+    int stepCount;
+    int roundNumber;
+    int decidedRound;
+    int decidedOutcome;
+    int stoppedEarly;
+    int birimSayisi[2];
+    long long int units[];               // Per unit: kalanBirimSayisi, saglik, saldiri, savunma
+} ResultCacheEntry;
+
+struct ResultCache {
+    CRITICAL_SECTION lock;
+    ResultCacheEntry **entries;
+    int count;
+    int capacity;
+    int *index;                          // Open addressing over entries, -1 = empty
+    int indexSize;                       // Power of two, at least twice 'count'
+    int maxEntries;
+    unsigned long long int clock;        // Source of lastUsed
+    long long int hits;
+    long long int misses;
+    long long int evictions;
+};
+
+// Hash one 64-bit word into both halves of the key
+static void resultCacheAdd(unsigned long long int key[2], unsigned long long int word) {
+    key[0] = (key[0] ^ word) * 0x100000001B3ULL;
+    key[1] = randomMix64(key[1] + RANDOM_GOLDEN_GAMMA * (word + 1));
+}
+
+// Key of everything that decides how 'ctx' plays out from here
+static void resultCacheKey(const BattleContext *ctx, unsigned long long int key[2]) {
+    const BattleOptions *options = &ctx->options;
+    unsigned int fatigueBits;
+    memcpy(&fatigueBits, &options->fatiguePercentage, sizeof(fatigueBits));
+    key[0] = 0xCBF29CE484222325ULL;
+    key[1] = RESULT_CACHE_VERSION;
+    resultCacheAdd(key, RESULT_CACHE_VERSION);
+    resultCacheAdd(key, fatigueBits);
+    resultCacheAdd(key, (unsigned long long int)options->fatigueFrequency);
+    resultCacheAdd(key, (unsigned long long int)options->maxRounds);
+    resultCacheAdd(key, (unsigned long long int)options->casualtyMode);
+    resultCacheAdd(key, (unsigned long long int)options->simultaneousRounds);
+    resultCacheAdd(key, (unsigned long long int)options->decideCheckInterval);
+    resultCacheAdd(key, (unsigned long long int)options->finishAfterDecided);
+    resultCacheAdd(key, (unsigned long long int)options->randomCrits);
+    resultCacheAdd(key, options->randomCrits ? options->seed : 0);
+    resultCacheAdd(key, (unsigned long long int)ctx->roundNumber);
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        resultCacheAdd(key, (unsigned long long int)side->birimSayisi);
+        resultCacheAdd(key, (unsigned long long int)side->attackIndex);
+        for (int i = 0; i < side->birimSayisi; i++) {
+            resultCacheAdd(key, (unsigned long long int)side->kalanBirimSayisi[i]);
+            resultCacheAdd(key, (unsigned long long int)side->saldiri[i]);
+            resultCacheAdd(key, (unsigned long long int)side->savunma[i]);
+            resultCacheAdd(key, (unsigned long long int)side->saglik[i]);
+            resultCacheAdd(key, (unsigned long long int)side->maksimumSaglik[i]);
+            if (options->randomCrits) {
+                resultCacheAdd(key, (unsigned long long int)side->critChance[i]);
+            } else {
+                resultCacheAdd(key, (unsigned long long int)side->critThreshold[i]);
+                resultCacheAdd(key, (unsigned long long int)side->attackCount[i]);
+            }
+        }
+    }
+}
+
+static size_t resultCacheEntrySize(int humanUnits, int orcUnits) {
+    return sizeof(ResultCacheEntry) + (size_t)(humanUnits + orcUnits) * 4 * sizeof(long long int);
+}
+
+// Position of 'key' in the index, or of the empty slot where it belongs
+static int resultCacheSlot(const ResultCache *cache, const unsigned long long int key[2]) {
+    int mask = cache->indexSize - 1;
+    int slot = (int)(key[0] & (unsigned long long int)mask);
+    while (cache->index[slot] >= 0) {
+        const ResultCacheEntry *entry = cache->entries[cache->index[slot]];
+        if (entry->key[0] == key[0] && entry->key[1] == key[1]) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Rebuild the index for the current entries
+static bool resultCacheReindex(ResultCache *cache) {
+    int size = 64;
+    while (size < cache->count * 2 + 2) size *= 2;
+    int *index = (int *)malloc(size * sizeof(int));
+    if (index == NULL) return false;
+    free(cache->index);
+    cache->index = index;
+    cache->indexSize = size;
+    for (int i = 0; i < size; i++) index[i] = -1;
+    for (int e = 0; e < cache->count; e++) {
+        index[resultCacheSlot(cache, cache->entries[e]->key)] = e;
+    }
+    return true;
+}
+
+static int resultCacheCompareAge(const void *a, const void *b) {
+    unsigned long long int x = (*(ResultCacheEntry *const *)a)->lastUsed, y = (*(ResultCacheEntry *const *)b)->lastUsed;
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// Drop the least recently used entries until at most 7/8 of the limit is left
+static void resultCacheEvict(ResultCache *cache) {
+    int keep = cache->maxEntries - cache->maxEntries / 8;
+    if (cache->count <= cache->maxEntries) return;
+    qsort(cache->entries, cache->count, sizeof(ResultCacheEntry *), resultCacheCompareAge);
+    for (int e = keep; e < cache->count; e++) {
+        free(cache->entries[e]);
+    }
+    cache->evictions += cache->count - keep;
+    cache->count = keep;
+    resultCacheReindex(cache);
+}
+
+// Add an entry the cache takes ownership of; false if it could not
+static bool resultCacheInsert(ResultCache *cache, ResultCacheEntry *entry) {
+    if (cache->count == cache->capacity) {
+        int capacity = cache->capacity > 0 ? cache->capacity * 2 : 256;
+        ResultCacheEntry **grown = (ResultCacheEntry **)realloc(cache->entries, capacity * sizeof(ResultCacheEntry *));
+        if (grown == NULL) return false;
+        cache->entries = grown;
+        cache->capacity = capacity;
+    }
+    cache->entries[cache->count++] = entry;
+    if (cache->count * 2 + 2 > cache->indexSize) {
+        if (!resultCacheReindex(cache)) {
+            cache->count--;
+            return false;
+        }
+    } else {
+        cache->index[resultCacheSlot(cache, entry->key)] = cache->count - 1;
+    }
+    resultCacheEvict(cache);
+    return true;
+}
+
+// Open the cache stored at 'path' (a missing file starts an empty cache)
+bool resultCacheOpen(ResultCache *cache, const char *path, int maxEntries) {
+    memset(cache, 0, sizeof(*cache));
+    cache->maxEntries = maxEntries > 0 ? maxEntries : 1;
+    InitializeCriticalSection(&cache->lock);
+    if (!resultCacheReindex(cache)) {
+        DeleteCriticalSection(&cache->lock);
+        return false;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return true;
+    unsigned int header[4];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != RESULT_CACHE_MAGIC ||
+        header[1] != RESULT_CACHE_VERSION || header[2] != sizeof(ResultCacheEntry)) {
+        fprintf(stderr, "Ignoring result cache %s: unknown format\n", path);
+        fclose(file);
+        return true;
+    }
+    for (unsigned int e = 0; e < header[3]; e++) {
+        ResultCacheEntry head;
+        if (fread(&head, sizeof(head), 1, file) != 1 || head.birimSayisi[0] < 0 || head.birimSayisi[1] < 0) break;
+        ResultCacheEntry *entry = (ResultCacheEntry *)malloc(resultCacheEntrySize(head.birimSayisi[0], head.birimSayisi[1]));
+        if (entry == NULL) break;
+        *entry = head;
+        // Inserting may evict (and free) the entry itself, so take its age first
+        if (head.lastUsed > cache->clock) cache->clock = head.lastUsed;
+        size_t values = (size_t)(head.birimSayisi[0] + head.birimSayisi[1]) * 4;
+        if (fread(entry->units, sizeof(long long int), values, file) != values || !resultCacheInsert(cache, entry)) {
+            free(entry);
+            break;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// Write the cache to 'path' (through a temporary file) and free it
+bool resultCacheClose(ResultCache *cache, const char *path) {
+    bool ok = true;
+    if (path != NULL) {
+        char temporary[1024];
+        snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+        FILE *file = fopen(temporary, "wb");
+        ok = file != NULL;
+        if (ok) {
+            unsigned int header[4] = { RESULT_CACHE_MAGIC, RESULT_CACHE_VERSION, sizeof(ResultCacheEntry), (unsigned int)cache->count };
+            ok = fwrite(header, sizeof(header), 1, file) == 1;
+            for (int e = 0; e < cache->count && ok; e++) {
+                const ResultCacheEntry *entry = cache->entries[e];
+                ok = fwrite(entry, resultCacheEntrySize(entry->birimSayisi[0], entry->birimSayisi[1]), 1, file) == 1;
+            }
+            ok = fclose(file) == 0 && ok;
+            remove(path);
+            ok = ok && rename(temporary, path) == 0;
+        }
+        if (!ok) fprintf(stderr, "Failed to write result cache %s\n", path);
+    }
+    for (int e = 0; e < cache->count; e++) {
+        free(cache->entries[e]);
+    }
+    free(cache->entries);
+    free(cache->index);
+    DeleteCriticalSection(&cache->lock);
+    return ok;
+}
+
+void resultCachePrintStats(const ResultCache *cache) {
+    fprintf(stderr, "Result cache: %lld hits, %lld misses, %lld evicted, %d entries (limit %d)\n",
+            cache->hits, cache->misses, cache->evictions, cache->count, cache->maxEntries);
+}
+
+// True if 'ctx' may be answered from and stored in its cache: battles with a
+// log and battles that have already started always play
+static bool battleCacheable(const BattleContext *ctx) {
+    return ctx->cache != NULL && ctx->logFile == NULL && ctx->outcome == BATTLE_ONGOING && ctx->stepCount == 0;
+}
+
+// Finish 'ctx' from the cache entry of 'key'; false (a miss) if there is none
+static bool resultCacheLookup(BattleContext *ctx, const unsigned long long int key[2]) {
+    ResultCache *cache = ctx->cache;
+    EnterCriticalSection(&cache->lock);
+    int e = cache->index[resultCacheSlot(cache, key)];
+    if (e >= 0) {
+        ResultCacheEntry *entry = cache->entries[e];
+        if (entry->birimSayisi[0] == ctx->sides[0].birimSayisi && entry->birimSayisi[1] == ctx->sides[1].birimSayisi) {
+            entry->lastUsed = ++cache->clock;
+            cache->hits++;
+            ctx->outcome = (BattleOutcome)entry->outcome;
+            ctx->byRemainingUnits = entry->byRemainingUnits;
+            ctx->roundsPlayed = entry->roundsPlayed;
+            ctx->stepCount = entry->stepCount;
+            ctx->roundNumber = entry->roundNumber;
+            ctx->decidedRound = entry->decidedRound;
+            ctx->decidedOutcome = (BattleOutcome)entry->decidedOutcome;
+            ctx->stoppedEarly = entry->stoppedEarly;
+            const long long int *unit = entry->units;
+            for (int s = 0; s < 2; s++) {
+                BattleSide *side = &ctx->sides[s];
+                for (int i = 0; i < side->birimSayisi; i++, unit += 4) {
+                    side->kalanBirimSayisi[i] = unit[0];
+                    side->saglik[i] = (int)unit[1];
+                    side->saldiri[i] = (int)unit[2];
+                    side->savunma[i] = (int)unit[3];
+                }
+            }
+            ctx->fromCache = true;
+            LeaveCriticalSection(&cache->lock);
+            return true;
+        }
+    }
+    cache->misses++;
+    LeaveCriticalSection(&cache->lock);
+    return false;
+}
+
+// Store the result of the finished battle 'ctx' under 'key'
+static void resultCacheStore(const BattleContext *ctx, const unsigned long long int key[2]) {
+    ResultCache *cache = ctx->cache;
+    ResultCacheEntry *entry = (ResultCacheEntry *)malloc(resultCacheEntrySize(ctx->sides[0].birimSayisi, ctx->sides[1].birimSayisi));
+    if (entry == NULL) {
+        return;
+    }
+    entry->key[0] = key[0];
+    entry->key[1] = key[1];
+    entry->outcome = ctx->outcome;
+    entry->byRemainingUnits = ctx->byRemainingUnits;
+    entry->roundsPlayed = ctx->roundsPlayed;
+    entry->stepCount = ctx->stepCount;
+    entry->roundNumber = ctx->roundNumber;
+    entry->decidedRound = ctx->decidedRound;
+    entry->decidedOutcome = ctx->decidedOutcome;
+    entry->stoppedEarly = ctx->stoppedEarly;
+    entry->birimSayisi[0] = ctx->sides[0].birimSayisi;
+    entry->birimSayisi[1] = ctx->sides[1].birimSayisi;
+    long long int *unit = entry->units;
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        for (int i = 0; i < side->birimSayisi; i++, unit += 4) {
+            unit[0] = side->kalanBirimSayisi[i];
+            unit[1] = side->saglik[i];
+            unit[2] = side->saldiri[i];
+            unit[3] = side->savunma[i];
+        }
+    }
+
+    EnterCriticalSection(&cache->lock);
+    int slot = resultCacheSlot(cache, key);
+    if (cache->index[slot] >= 0) {
+        cache->entries[cache->index[slot]]->lastUsed = ++cache->clock; // Another thread stored it first
+        free(entry);
+    } else {
+        entry->lastUsed = ++cache->clock;
+        if (!resultCacheInsert(cache, entry)) free(entry);
+    }
+    LeaveCriticalSection(&cache->lock);
+}
+
+// battleRun through ctx->cache: a known state is answered from the cache,
+// anything else is played and stored
+BattleOutcome battleRunCached(BattleContext *ctx) {
+    if (!battleCacheable(ctx)) {
+        return battleRun(ctx);
+    }
+    unsigned long long int key[2];
+    resultCacheKey(ctx, key);
+    if (!resultCacheLookup(ctx, key)) {
+        battleRun(ctx);
+        resultCacheStore(ctx, key);
+    }
+    return ctx->outcome;
+}
+
+// Lockstep batch engine
+// Plays up to BATCH_LANES independent battles of at most BATCH_MAX_UNITS unit
+// types per side at the same time, using GCC/Clang vector types: each
+// BatchLane holds one field of one unit in all lanes, and branches are
+// replaced by masks, so one round of every lane runs as vector instructions.
+// A lane whose battle has ended is masked out until the next waiting battle is
+// loaded into it. The results are the same as battleRun; there is no logging,
+// quiet-round skipping or outcome bound.
+// The lane count follows the widest vector unit the build targets: build with
+// GCC or Clang and -mavx2 (4 lanes), -mavx512f (8 lanes) or -march=native on
+// such a CPU. A build without these flags, or with other compilers, has no
+// lanes and battleRunMany simply calls battleRun; --batch-benchmark reports
+// the lane count of the build.
+#if defined(__GNUC__) && (defined(__AVX512F__) || defined(__AVX2__))
+#define BATTLE_BATCH_SIMD 1
+
+#if defined(__AVX512F__)
+#define BATCH_LANES 8
+#else
+#define BATCH_LANES 4
+#endif
+#define BATCH_MAX_UNITS 4 // Must be a power of two (the cursor wraps with a mask)
+
+// One 64-bit value per lane; comparisons yield -1 (true) or 0 per lane.
+// Only 8-byte alignment is assumed, so heap blocks from malloc are fine.
+typedef long long int BatchLane __attribute__((vector_size(BATCH_LANES * sizeof(long long int)), aligned(sizeof(long long int))));
+typedef unsigned long long int BatchLaneU __attribute__((vector_size(BATCH_LANES * sizeof(long long int)), aligned(sizeof(long long int))));
+
+typedef struct {
+    BatchLane kalanBirimSayisi[2][BATCH_MAX_UNITS];
+    BatchLane saldiri[2][BATCH_MAX_UNITS];
+    BatchLane savunma[2][BATCH_MAX_UNITS];
+    BatchLane saglik[2][BATCH_MAX_UNITS];
+    BatchLane maksimumSaglik[2][BATCH_MAX_UNITS];
+    BatchLane attackCount[2][BATCH_MAX_UNITS];
+    BatchLane critThreshold[2][BATCH_MAX_UNITS];
+    BatchLane attackIndex[2];
+    BatchLane active;                  // -1 while a running battle occupies the lane
+    int roundNumber[BATCH_LANES];
+    BattleContext *battles[BATCH_LANES];
+    BattleOptions options;             // Shared by all lanes
+} BattleBatch;
+
+// The same value in every lane
+static inline BatchLane batchBroadcast(long long int value) {
+    BatchLane lanes = { 0 };
+    return lanes + value;
+}
+
+// Per lane: 'mask' ? a : b
+static inline BatchLane batchSelect(BatchLane mask, BatchLane a, BatchLane b) {
+    return (a & mask) | (b & ~mask);
+}
+
+// True if 'ctx' can run in the batch engine at all
+static bool battleBatchable(const BattleContext *ctx) {
+    return ctx->outcome == BATTLE_ONGOING && ctx->logFile == NULL && ctx->options.decideCheckInterval <= 0 &&
+           !ctx->options.simultaneousRounds && !ctx->options.randomCrits &&
+           ctx->sides[SIDE_HUMAN].birimSayisi <= BATCH_MAX_UNITS && ctx->sides[SIDE_ORC].birimSayisi <= BATCH_MAX_UNITS;
+}
+
+// True if two battles play by the same rules and can share a batch
+static bool battleBatchCompatible(const BattleOptions *a, const BattleOptions *b) {
+    return a->fatiguePercentage == b->fatiguePercentage && a->fatigueFrequency == b->fatigueFrequency &&
+           a->maxRounds == b->maxRounds && a->casualtyMode == b->casualtyMode;
+}
+
+// Put 'ctx' into lane 'l'; unused unit slots stay empty and are never targeted
+static void battleBatchLoadLane(BattleBatch *batch, int l, BattleContext *ctx) {
+    batch->battles[l] = ctx;
+    batch->active[l] = -1;
+    batch->roundNumber[l] = ctx->roundNumber;
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        batch->attackIndex[s][l] = side->attackIndex;
+        for (int i = 0; i < BATCH_MAX_UNITS; i++) {
+            bool used = i < side->birimSayisi;
+            batch->kalanBirimSayisi[s][i][l] = used ? side->kalanBirimSayisi[i] : 0;
+            batch->saldiri[s][i][l] = used ? side->saldiri[i] : 0;
+            batch->savunma[s][i][l] = used ? side->savunma[i] : 0;
+            batch->saglik[s][i][l] = used ? side->saglik[i] : 0;
+            batch->maksimumSaglik[s][i][l] = used ? side->maksimumSaglik[i] : 0;
+            batch->attackCount[s][i][l] = used ? side->attackCount[i] : 0;
+            batch->critThreshold[s][i][l] = used ? side->critThreshold[i] : INT_MAX;
+        }
+    }
+}
+
+// Write lane 'l' back into its BattleContext
+static void battleBatchStoreLane(const BattleBatch *batch, int l, BattleOutcome outcome, bool byRemainingUnits) {
+    BattleContext *ctx = batch->battles[l];
+    ctx->stepCount += batch->roundNumber[l] - ctx->roundNumber;
+    ctx->roundNumber = batch->roundNumber[l];
+    ctx->roundsPlayed = batch->roundNumber[l] - 1;
+    ctx->outcome = outcome;
+    ctx->byRemainingUnits = byRemainingUnits;
+    for (int s = 0; s < 2; s++) {
+        BattleSide *side = &ctx->sides[s];
+        // Empty slots are never targeted, so the cursor maps back directly
+        if (side->birimSayisi > 0) {
+            side->attackIndex = (int)(batch->attackIndex[s][l] % side->birimSayisi);
+        }
+        for (int i = 0; i < side->birimSayisi; i++) {
+            side->kalanBirimSayisi[i] = batch->kalanBirimSayisi[s][i][l];
+            side->saldiri[i] = (int)batch->saldiri[s][i][l];
+            side->savunma[i] = (int)batch->savunma[s][i][l];
+            side->saglik[i] = (int)batch->saglik[s][i][l];
+            side->attackCount[i] = (int)batch->attackCount[s][i][l];
+        }
+    }
+}
+
+// Unit 'i' of side 'a' attacks in every lane: crit check, attack power, target
+// choice and damage. Returns the hit unit per lane (-1 = none) and the damage.
+static BatchLane battleBatchAim(BattleBatch *batch, int a, int i, BatchLane *damageOut) {
+    const int d = 1 - a;
+    BatchLane count = batch->kalanBirimSayisi[a][i];
+    BatchLane attacking = batch->active & (count > 0);
+
+    // Scheduled crit counter (attacking is -1, so subtracting it counts up)
+    BatchLane attackCount = batch->attackCount[a][i] - attacking;
+    BatchLane isCritical = attacking & (attackCount >= batch->critThreshold[a][i]);
+    batch->attackCount[a][i] = attackCount & ~isCritical;
+
+    // x + x / 2 equals (long long)(x * 1.5) for every non-negative x below 2^53
+    BatchLane attackPower = batch->saldiri[a][i] * count;
+    attackPower += (attackPower >> 1) & isCritical;
+    // Minimum damage of calculateNetDamage: attackPower * 5 / 100, at least 1.
+    // It only matters when attackPower <= savunma < 2^31, where x / 20 is exactly
+    // (x * 0xCCCCCCCD) >> 36 and needs no vector division
+    BatchLane minimumDamage = (BatchLane)((((BatchLaneU)attackPower & 0xFFFFFFFFu) * 0xCCCCCCCDu) >> 36);
+    minimumDamage = batchSelect(minimumDamage == 0, batchBroadcast(1), minimumDamage);
+
+    // Target: the living enemy unit closest to the cursor in cursor order
+    BatchLane cursor = batch->attackIndex[d];
+    BatchLane target = batchBroadcast(-1);
+    BatchLane bestDistance = batchBroadcast(BATCH_MAX_UNITS);
+    BatchLane damage = batchBroadcast(0);
+    for (int j = 0; j < BATCH_MAX_UNITS; j++) {
+        BatchLane distance = (j - cursor) & (BATCH_MAX_UNITS - 1);
+        BatchLane closer = (batch->kalanBirimSayisi[d][j] > 0) & (distance < bestDistance);
+        BatchLane netDamage = attackPower - batch->savunma[d][j];
+        netDamage = batchSelect(netDamage <= 0, minimumDamage, netDamage);
+        bestDistance = batchSelect(closer, distance, bestDistance);
+        target = batchSelect(closer, batchBroadcast(j), target);
+        damage = batchSelect(closer, netDamage, damage);
+    }
+    target = batchSelect(attacking, target, batchBroadcast(-1));
+    batch->attackIndex[d] = batchSelect(target >= 0, (target + 1) & (BATCH_MAX_UNITS - 1), cursor);
+    *damageOut = batchSelect(attackPower == 0, batchBroadcast(0), damage);
+    return target;
+}
+
+// Apply the hits to side 'd' with one death per lethal hit
+static void battleBatchApplySingle(BattleBatch *batch, int d, BatchLane target, BatchLane damage) {
+    for (int j = 0; j < BATCH_MAX_UNITS; j++) {
+        BatchLane hit = target == j;
+        BatchLane saglik = batch->saglik[d][j];
+        // saglik is an int in BattleSide, so the difference wraps to 32 bits there
+        BatchLane remaining = (BatchLane)((BatchLaneU)(saglik - damage) << 32) >> 32;
+        BatchLane died = hit & (remaining <= 0);
+        batch->saglik[d][j] = batchSelect(died, batch->maksimumSaglik[d][j], batchSelect(hit, remaining, saglik));
+        batch->kalanBirimSayisi[d][j] += died;
+    }
+}
+
+// Apply the hits to side 'd' with the rule of applyBulkCasualties; the
+// divisions keep this part one lane at a time
+static void battleBatchApplyBulk(BattleBatch *batch, int d, BatchLane target, BatchLane damage) {
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (target[l] < 0) continue;
+        int t = (int)target[l];
+        long long int saglik = batch->saglik[d][t][l];
+        long long int maksimumSaglik = batch->maksimumSaglik[d][t][l];
+        if (damage[l] < saglik) {
+            batch->saglik[d][t][l] = saglik - damage[l];
+            continue;
+        }
+        long long int effectiveDamage = damage[l] + (maksimumSaglik - saglik);
+        long long int unitsLost = calculateUnitsLost(effectiveDamage, maksimumSaglik);
+        if (unitsLost >= batch->kalanBirimSayisi[d][t][l]) {
+            unitsLost = batch->kalanBirimSayisi[d][t][l];
+            batch->saglik[d][t][l] = maksimumSaglik;
+        } else {
+            batch->saglik[d][t][l] = maksimumSaglik - effectiveDamage % maksimumSaglik;
+        }
+        batch->kalanBirimSayisi[d][t][l] -= unitsLost;
+    }
+}
+
+// Play one round in every active lane
+static void battleBatchRound(BattleBatch *batch) {
+    // Fatigue only hits the lanes whose round is a fatigue round
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (!batch->active[l] || batch->roundNumber[l] % batch->options.fatigueFrequency != 0) continue;
+        for (int s = 0; s < 2; s++) {
+            for (int i = 0; i < BATCH_MAX_UNITS; i++) {
+                int saldiri = (int)batch->saldiri[s][i][l];
+                int savunma = (int)batch->savunma[s][i][l];
+                applyFatigueEffect(&saldiri, &savunma, batch->options.fatiguePercentage);
+                batch->saldiri[s][i][l] = saldiri;
+                batch->savunma[s][i][l] = savunma;
+            }
+        }
+    }
+
+    // Humans attack first, then orcs, one attacking unit type at a time
+    for (int a = 0; a < 2; a++) {
+        for (int i = 0; i < BATCH_MAX_UNITS; i++) {
+            BatchLane damage;
+            BatchLane target = battleBatchAim(batch, a, i, &damage);
+            if (batch->options.casualtyMode == CASUALTY_BULK) {
+                battleBatchApplyBulk(batch, 1 - a, target, damage);
+            } else {
+                battleBatchApplySingle(batch, 1 - a, target, damage);
+            }
+        }
+    }
+
+    for (int l = 0; l < BATCH_LANES; l++) {
+        batch->roundNumber[l] += batch->active[l] != 0;
+    }
+}
+
+// End-of-round checks of battleStep for lane 'l'; returns BATTLE_ONGOING or the result
+static BattleOutcome battleBatchLaneOutcome(const BattleBatch *batch, int l, bool *byRemainingUnits) {
+    long long int totals[2] = { 0, 0 };
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < BATCH_MAX_UNITS; i++) {
+            totals[s] += batch->kalanBirimSayisi[s][i][l];
+        }
+    }
+    BattleOutcome outcome = BATTLE_ONGOING;
+    if (totals[SIDE_HUMAN] == 0 && totals[SIDE_ORC] == 0) {
+        outcome = BATTLE_DRAW;
+    } else if (totals[SIDE_HUMAN] == 0) {
+        outcome = BATTLE_ORCS_WIN;
+    } else if (totals[SIDE_ORC] == 0) {
+        outcome = BATTLE_HUMANS_WIN;
+    }
+    *byRemainingUnits = false;
+    // roundNumber already points at the next round
+    if (batch->roundNumber[l] - 1 >= batch->options.maxRounds) {
+        *byRemainingUnits = outcome == BATTLE_ONGOING;
+        if (totals[SIDE_HUMAN] > totals[SIDE_ORC]) {
+            outcome = BATTLE_HUMANS_WIN;
+        } else if (totals[SIDE_ORC] > totals[SIDE_HUMAN]) {
+            outcome = BATTLE_ORCS_WIN;
+        } else {
+            outcome = BATTLE_DRAW;
+        }
+    }
+    return outcome;
+}
+
+// Play all given battles to the end. Battles that fit the batch engine run in
+// the lanes, and a lane is refilled as soon as its battle ends; the rest
+// (logging, outcome bound, more unit types) fall back to battleRun. Results
+// are identical either way.
+void battleRunMany(BattleContext *battles, int count) {
+    BattleBatch *batch = (BattleBatch *)malloc(sizeof(BattleBatch));
+    for (int k = 0; k < count; k++) {
+        if (battles[k].outcome == BATTLE_ONGOING && (batch == NULL || !battleBatchable(&battles[k]))) {
+            battleRun(&battles[k]);
+        }
+    }
+    if (batch == NULL) return;
+
+    // One pass per set of rules; a pass starts at the first battle still waiting
+    int next = 0;
+    for (;;) {
+        while (next < count && battles[next].outcome != BATTLE_ONGOING) next++;
+        if (next == count) break;
+
+        memset(batch, 0, sizeof(*batch));
+        batch->options = battles[next].options;
+        int cursor = next;
+        int running = 0;
+        for (;;) {
+            // Fill idle lanes with waiting battles of the same rules
+            for (int l = 0; l < BATCH_LANES; l++) {
+                if (batch->active[l]) continue;
+                while (cursor < count && (battles[cursor].outcome != BATTLE_ONGOING ||
+                       !battleBatchCompatible(&batch->options, &battles[cursor].options))) {
+                    cursor++;
+                }
+                if (cursor == count) break;
+                battleBatchLoadLane(batch, l, &battles[cursor++]);
+                running++;
+            }
+            if (running == 0) break;
+
+            battleBatchRound(batch);
+
+            for (int l = 0; l < BATCH_LANES; l++) {
+                if (!batch->active[l]) continue;
+                bool byRemainingUnits;
+                BattleOutcome outcome = battleBatchLaneOutcome(batch, l, &byRemainingUnits);
+                if (outcome != BATTLE_ONGOING) {
+                    battleBatchStoreLane(batch, l, outcome, byRemainingUnits);
+                    batch->active[l] = 0;
+                    running--;
+                }
+            }
+        }
+    }
+    free(batch);
+}
+#else
+#define BATCH_LANES 1
+
+// Play all given battles to the end
+void battleRunMany(BattleContext *battles, int count) {
+    for (int k = 0; k < count; k++) {
+        if (battles[k].outcome == BATTLE_ONGOING) battleRun(&battles[k]);
+    }
+}
+#endif
+
+// Battles a task hands to battleRunManyCached at a time: a few per lane, so
+// idle lanes are refilled while the others still run
+#define BATTLE_RUN_GROUP (4 * BATCH_LANES)
+
+// battleRunMany through each battle's cache, as battleRunCached does for one:
+// known states are answered from the cache, the rest share the lanes and are stored
+void battleRunManyCached(BattleContext *battles, int count) {
+    unsigned long long int (*keys)[2] = (unsigned long long int (*)[2])malloc((count + 1) * sizeof(*keys));
+    bool *missed = (bool *)calloc(count + 1, sizeof(bool));
+    for (int k = 0; k < count && keys != NULL && missed != NULL; k++) {
+        if (!battleCacheable(&battles[k])) continue;
+        resultCacheKey(&battles[k], keys[k]);
+        missed[k] = !resultCacheLookup(&battles[k], keys[k]);
+    }
+    battleRunMany(battles, count);
+    for (int k = 0; k < count && keys != NULL && missed != NULL; k++) {
+        if (missed[k]) resultCacheStore(&battles[k], keys[k]);
+    }
+    free(keys);
+    free(missed);
+}
+
+// Battles per task when 'count' battles are spread over 'pool': up to
+// BATTLE_RUN_GROUP, but few enough that every thread still gets some
+static int battleGroupSize(const WorkerPool *pool, int count) {
+    int threads = pool != NULL ? pool->threadCount + 1 : 1;
+    int size = count / threads;
+    if (size > BATTLE_RUN_GROUP) size = BATTLE_RUN_GROUP;
+    return size > 0 ? size : 1;
+}
+
+// Tasks of battleGroupSize battles each for 'count' battles
+static int battleGroupCount(int count, int groupSize) {
+    return (count + groupSize - 1) / groupSize;
+}
+
+// Time battleRun against battleRunMany on 'count' copies of 'base' with
+// scaled armies and check that both give the same results
+void runBatchBenchmark(const BattleContext *base, int count) {
+    static const double scales[] = { 0.25, 0.5, 1.0, 2.0, 4.0 };
+    const int scaleCount = (int)(sizeof(scales) / sizeof(scales[0]));
+    BattleContext *scalar = (BattleContext *)calloc(count, sizeof(BattleContext));
+    BattleContext *batched = (BattleContext *)calloc(count, sizeof(BattleContext));
+    if (scalar == NULL || batched == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(scalar);
+        free(batched);
+        return;
+    }
+
+    int created = 0;
+    for (; created < count; created++) {
+        if (!battleClone(&scalar[created], base)) break;
+        scalar[created].logFile = NULL;
+        scalar[created].options.decideCheckInterval = 0;
+        battleScaleCounts(&scalar[created], SIDE_HUMAN, scales[created % scaleCount]);
+        battleScaleCounts(&scalar[created], SIDE_ORC, scales[(created / scaleCount) % scaleCount]);
+        if (!battleClone(&batched[created], &scalar[created])) {
+            battleDestroy(&scalar[created]);
+            break;
+        }
+    }
+
+    clock_t start = clock();
+    for (int k = 0; k < created; k++) {
+        battleRun(&scalar[k]);
+    }
+    double scalarSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    battleRunMany(batched, created);
+    double batchSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    int mismatches = 0;
+    long long int rounds = 0;
+    for (int k = 0; k < created; k++) {
+        bool same = scalar[k].outcome == batched[k].outcome && scalar[k].roundsPlayed == batched[k].roundsPlayed;
+        for (int s = 0; s < 2 && same; s++) {
+            for (int i = 0; i < scalar[k].sides[s].birimSayisi; i++) {
+                if (scalar[k].sides[s].kalanBirimSayisi[i] != batched[k].sides[s].kalanBirimSayisi[i] ||
+                    scalar[k].sides[s].saglik[i] != batched[k].sides[s].saglik[i]) {
+                    same = false;
+                }
+            }
+        }
+        if (!same) mismatches++;
+        rounds += scalar[k].roundsPlayed;
+        battleDestroy(&scalar[k]);
+        battleDestroy(&batched[k]);
+    }
+    free(scalar);
+    free(batched);
+
+    printf("Batch benchmark: %d battles, %lld rounds, %d lanes\n", created, rounds, BATCH_LANES);
+    if (BATCH_LANES == 1) {
+        printf("This build has no batch lanes; compile with -mavx2 or -mavx512f (GCC/Clang) to get them.\n");
+    }
+    printf("Scalar engine: %.3f s\n", scalarSeconds);
+    printf("Batch engine: %.3f s (%.2fx)\n", batchSeconds, batchSeconds > 0.0 ? scalarSeconds / batchSeconds : 0.0);
+    printf("Mismatching results: %d\n", mismatches);
+}
+
+
+// Fill 'dst' with every unit type of 'src' repeated 'copies' times; copy k
+// gets (k % 4 + 1) / 4 of the original army so the copies die at different times
+static bool battleSideReplicate(BattleSide *dst, const BattleSide *src, int copies) {
+    memcpy(dst->etiket, src->etiket, sizeof(dst->etiket));
+    memcpy(dst->cogulEtiket, src->cogulEtiket, sizeof(dst->cogulEtiket));
+    dst->attackIndex = 0;
+    if (!battleSideAllocate(dst, src->birimSayisi * copies)) {
+        return false;
+    }
+    for (int k = 0; k < copies; k++) {
+        for (int i = 0; i < src->birimSayisi; i++) {
+            int j = k * src->birimSayisi + i;
+            long long int count = src->kalanBirimSayisi[i] * (k % 4 + 1) / 4;
+            dst->kalanBirimSayisi[j] = (src->kalanBirimSayisi[i] > 0 && count < 1) ? 1 : count;
+            dst->saldiri[j] = src->saldiri[i];
+            dst->savunma[j] = src->savunma[i];
+            dst->saglik[j] = src->saglik[i];
+            dst->maksimumSaglik[j] = src->maksimumSaglik[i];
+            dst->attackCount[j] = src->attackCount[i];
+            dst->critThreshold[j] = src->critThreshold[i];
+            dst->critChance[j] = src->critChance[i];
+            dst->bilgi[j] = src->bilgi[i];
+            snprintf(dst->bilgi[j].isim, sizeof(dst->bilgi[j].isim), "%.36s #%d", src->bilgi[i].isim, k + 1);
+        }
+    }
+    return true;
+}
+
+// Time simultaneous rounds on one thread and on 'pool' for a battle with every
+// unit type of 'base' repeated 'copies' times, and check both give the same result
+void runParallelBenchmark(const BattleContext *base, int copies, WorkerPool *pool) {
+    BattleContext serial = *base;
+    serial.logFile = NULL;
+    serial.pool = NULL;
+    serial.options.simultaneousRounds = true;
+    serial.options.decideCheckInterval = 0;
+    if (!battleSideReplicate(&serial.sides[SIDE_HUMAN], &base->sides[SIDE_HUMAN], copies)) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return;
+    }
+    if (!battleSideReplicate(&serial.sides[SIDE_ORC], &base->sides[SIDE_ORC], copies)) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        battleSideDestroy(&serial.sides[SIDE_HUMAN]);
+        return;
+    }
+    BattleContext parallel;
+    if (!battleClone(&parallel, &serial)) {
+        battleDestroy(&serial);
+        return;
+    }
+    parallel.pool = pool;
+
+    double start = wallClockSeconds();
+    battleRun(&serial);
+    double serialSeconds = wallClockSeconds() - start;
+    start = wallClockSeconds();
+    battleRun(&parallel);
+    double parallelSeconds = wallClockSeconds() - start;
+
+    bool same = serial.outcome == parallel.outcome && serial.roundsPlayed == parallel.roundsPlayed;
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < serial.sides[s].birimSayisi; i++) {
+            if (serial.sides[s].kalanBirimSayisi[i] != parallel.sides[s].kalanBirimSayisi[i] ||
+                serial.sides[s].saglik[i] != parallel.sides[s].saglik[i]) {
+                same = false;
+            }
+        }
+    }
+
+    printf("Parallel benchmark: %d unit types per side, %d rounds, winner %s\n",
+           serial.sides[SIDE_HUMAN].birimSayisi, serial.roundsPlayed, battleOutcomeName(serial.outcome));
+    printf("1 thread: %.3f s\n", serialSeconds);
+    printf("%d threads: %.3f s\n", pool != NULL ? pool->threadCount + 1 : 1, parallelSeconds);
+    printf("Results identical: %s\n", same ? "yes" : "NO");
+    battleDestroy(&serial);
+    battleDestroy(&parallel);
+}
+
+// Monte Carlo driver
+// Plays 'replicas' copies of one battle with random crits, replica r seeded
+// with battleDeriveSeed(seed, r). Replicas are grouped in fixed chunks whose
+// integer tallies are combined in chunk order, so the report is the same for
+// any number of threads. A chunk goes through battleRunManyCached as a whole;
+// the batch engine has no random crits, so the replicas play one by one there.
+
+// Replicas per parallel task
+#define MONTE_CARLO_CHUNK 64
+
+typedef struct {
+    long long int outcomes[4];    // Indexed by BattleOutcome
+    long long int roundsSum;
+    int minRounds;
+    int maxRounds;
+    long long int *survivorSums;  // Human unit types, then orc unit types
+} MonteCarloTally;
+
+typedef struct {
+    const BattleContext *base;
+    int replicas;
+    MonteCarloTally *tallies;
+    volatile LONG failed;
+} MonteCarloJob;
+
+// Play the replicas of one chunk together and tally them
+static void monteCarloTask(void *arg, int chunk) {
+    MonteCarloJob *job = (MonteCarloJob *)arg;
+    MonteCarloTally *tally = &job->tallies[chunk];
+    int first = chunk * MONTE_CARLO_CHUNK;
+    int count = job->replicas - first < MONTE_CARLO_CHUNK ? job->replicas - first : MONTE_CARLO_CHUNK;
+    BattleContext *replicas = (BattleContext *)calloc(count, sizeof(BattleContext));
+    int ready = 0;
+    while (replicas != NULL && ready < count && battleClone(&replicas[ready], job->base)) {
+        replicas[ready].options.seed = battleDeriveSeed(job->base->options.seed, first + ready);
+        ready++;
+    }
+    if (ready < count) {
+        InterlockedIncrement(&job->failed);
+    } else {
+        battleRunManyCached(replicas, count);
+    }
+    tally->minRounds = INT_MAX;
+    for (int r = 0; r < ready; r++) {
+        BattleContext *replica = &replicas[r];
+        if (ready == count) {
+            tally->outcomes[replica->outcome]++;
+            tally->roundsSum += replica->roundsPlayed;
+            if (replica->roundsPlayed < tally->minRounds) tally->minRounds = replica->roundsPlayed;
+            if (replica->roundsPlayed > tally->maxRounds) tally->maxRounds = replica->roundsPlayed;
+            int k = 0;
+            for (int s = 0; s < 2; s++) {
+                for (int i = 0; i < replica->sides[s].birimSayisi; i++) {
+                    tally->survivorSums[k++] += replica->sides[s].kalanBirimSayisi[i];
+                }
+            }
+        }
+        battleDestroy(replica);
+    }
+    free(replicas);
+}
+
+// 95% Wilson score interval for 'successes' out of 'trials'
+static void wilsonInterval(long long int successes, long long int trials, double *low, double *high) {
+    const double z = 1.959963984540054;
+    double n = (double)trials;
+    double p = successes / n;
+    double denominator = 1.0 + z * z / n;
+    double center = (p + z * z / (2.0 * n)) / denominator;
+    double halfWidth = z * sqrt(p * (1.0 - p) / n + z * z / (4.0 * n * n)) / denominator;
+    *low = center - halfWidth > 0.0 ? center - halfWidth : 0.0;
+    *high = center + halfWidth < 1.0 ? center + halfWidth : 1.0;
+}
+
+// Report win probabilities, rounds and mean survivors over 'replicas' runs of 'base'
+void runMonteCarlo(const BattleContext *base, int replicas, WorkerPool *pool) {
+    BattleContext start = *base;
+    start.logFile = NULL;
+    start.pool = NULL; // Replicas run inside pool tasks
+    start.options.randomCrits = true;
+
+    int chunks = (replicas + MONTE_CARLO_CHUNK - 1) / MONTE_CARLO_CHUNK;
+    int unitTypes = base->sides[SIDE_HUMAN].birimSayisi + base->sides[SIDE_ORC].birimSayisi;
+    MonteCarloTally *tallies = (MonteCarloTally *)calloc(chunks, sizeof(MonteCarloTally));
+    long long int *survivorSums = (long long int *)calloc((size_t)chunks * unitTypes + 1, sizeof(long long int));
+    if (tallies == NULL || survivorSums == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(tallies);
+        free(survivorSums);
+        return;
+    }
+    for (int c = 0; c < chunks; c++) {
+        tallies[c].survivorSums = survivorSums + (size_t)c * unitTypes;
+    }
+
+    MonteCarloJob job = { &start, replicas, tallies, 0 };
+    double startTime = wallClockSeconds();
+    parallelFor(pool, chunks, monteCarloTask, &job);
+    double seconds = wallClockSeconds() - startTime;
+    if (job.failed > 0) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(tallies);
+        free(survivorSums);
+        return;
+    }
+
+    // Combine in chunk order
+    MonteCarloTally total = { {0}, 0, INT_MAX, 0, NULL };
+    double *meanSurvivors = (double *)calloc(unitTypes + 1, sizeof(double));
+    for (int c = 0; c < chunks; c++) {
+        for (int o = 0; o < 4; o++) total.outcomes[o] += tallies[c].outcomes[o];
+        total.roundsSum += tallies[c].roundsSum;
+        if (tallies[c].minRounds < total.minRounds) total.minRounds = tallies[c].minRounds;
+        if (tallies[c].maxRounds > total.maxRounds) total.maxRounds = tallies[c].maxRounds;
+        for (int k = 0; k < unitTypes && meanSurvivors != NULL; k++) {
+            meanSurvivors[k] += (double)tallies[c].survivorSums[k] / replicas;
+        }
+    }
+
+    printf("Monte Carlo: %d replicas, seed %llu, %d threads, %.3f s\n",
+           replicas, base->options.seed, pool != NULL ? pool->threadCount + 1 : 1, seconds);
+    static const BattleOutcome reported[] = { BATTLE_HUMANS_WIN, BATTLE_ORCS_WIN, BATTLE_DRAW };
+    for (int o = 0; o < 3; o++) {
+        double low, high;
+        wilsonInterval(total.outcomes[reported[o]], replicas, &low, &high);
+        printf("%s: %.4f (95%% CI %.4f - %.4f)\n", battleOutcomeName(reported[o]),
+               (double)total.outcomes[reported[o]] / replicas, low, high);
+    }
+    printf("Rounds: mean %.1f, min %d, max %d\n", (double)total.roundsSum / replicas, total.minRounds, total.maxRounds);
+    if (meanSurvivors != NULL) {
+        int k = 0;
+        for (int s = 0; s < 2; s++) {
+            printf("%s:\n", base->sides[s].cogulEtiket);
+            for (int i = 0; i < base->sides[s].birimSayisi; i++) {
+                printf(" - %s: %.2f units remaining on average\n", base->sides[s].bilgi[i].isim, meanSurvivors[k++]);
+            }
+        }
+    }
+    free(meanSurvivors);
+    free(tallies);
+    free(survivorSums);
+}
+
+// Minimum army search
+// Finds the smallest unit counts of one side that still beat the other side
+// as set up in 'base', using the engine as the oracle. It assumes that more
+// units never turn a win into a loss. Every search step probes several
+// counts at once on the worker pool: galloping (doubling) until a winning
+// count is found, then splitting the remaining gap into equal parts until the
+// smallest winning count is known. Probes only need the winner, so they run
+// with quiet-round skipping and the outcome bound switched on; the bound
+// keeps them out of the batch engine's lanes.
+
+// Largest count the galloping phase tries
+#define MIN_ARMY_LIMIT 1000000000000000LL
+#define MIN_ARMY_MAX_PROBES 64
+
+typedef struct {
+    const BattleContext *base;
+    int side;
+    int probeCount;
+    long long int *counts;     // Unit counts of 'side' per probe
+    int groupSize;             // Probes per task, played together
+    bool wins[MIN_ARMY_MAX_PROBES];
+    volatile LONG failed;
+} ArmyProbeJob;
+
+typedef struct {
+    ArmyProbeJob job;
+    int parallelProbes;
+    long long int probesRun;
+    WorkerPool *pool;
+    // Shape of the army for a search value x
+    int unitIndex;             // Only this type changes (-1 = scale the whole army)
+    const long long int *fixed;// Counts of the other types
+    long long int scaleBase;   // x == scaleBase means the counts in 'fixed'
+} ArmySearch;
+
+static void armyProbeTask(void *arg, int group) {
+    ArmyProbeJob *job = (ArmyProbeJob *)arg;
+    int first = group * job->groupSize;
+    int count = job->probeCount - first < job->groupSize ? job->probeCount - first : job->groupSize;
+    BattleContext probes[MIN_ARMY_MAX_PROBES];
+    int ready = 0;
+    while (ready < count && battleClone(&probes[ready], job->base)) {
+        BattleSide *side = &probes[ready].sides[job->side];
+        memcpy(side->kalanBirimSayisi, job->counts + (size_t)(first + ready) * side->birimSayisi,
+               side->birimSayisi * sizeof(long long int));
+        ready++;
+    }
+    if (ready < count) {
+        InterlockedIncrement(&job->failed);
+    } else {
+        battleRunManyCached(probes, count);
+        for (int p = 0; p < count; p++) {
+            job->wins[first + p] = probes[p].outcome == (job->side == SIDE_HUMAN ? BATTLE_HUMANS_WIN : BATTLE_ORCS_WIN);
+        }
+    }
+    for (int p = 0; p < ready; p++) battleDestroy(&probes[p]);
+}
+
+// Unit counts of the searched side for search value 'x'
+static void armyShape(const ArmySearch *search, long long int x, long long int *counts) {
+    int n = search->job.base->sides[search->job.side].birimSayisi;
+    for (int i = 0; i < n; i++) {
+        if (search->unitIndex >= 0) {
+            counts[i] = i == search->unitIndex ? x : search->fixed[i];
+        } else {
+            // ceil(fixed * x / scaleBase) without overflowing
+            long long int q = search->fixed[i] / search->scaleBase, r = search->fixed[i] % search->scaleBase;
+            counts[i] = q * x + (long long int)(((double)r * x + search->scaleBase - 1) / search->scaleBase);
+        }
+    }
+}
+
+// Play the given search values; false if a probe could not be set up
+static bool armyProbe(ArmySearch *search, const long long int *values, int count) {
+    int n = search->job.base->sides[search->job.side].birimSayisi;
+    for (int p = 0; p < count; p++) {
+        armyShape(search, values[p], search->job.counts + (size_t)p * n);
+    }
+    search->job.probeCount = count;
+    search->job.groupSize = battleGroupSize(search->pool, count);
+    search->job.failed = 0;
+    parallelFor(search->pool, battleGroupCount(count, search->job.groupSize), armyProbeTask, &search->job);
+    search->probesRun += count;
+    return search->job.failed == 0;
+}
+
+// Smallest x >= 0 that wins, given that 'lose' (-1 = nothing known) loses;
+// 'win' is a known winning value or -1 to gallop up from 'start'.
+// Returns -1 if nothing up to MIN_ARMY_LIMIT wins, -2 on allocation failure.
+static long long int armySearchMinimum(ArmySearch *search, long long int lose, long long int win, long long int start) {
+    long long int values[MIN_ARMY_MAX_PROBES];
+    int probes = search->parallelProbes;
+
+    // Gallop: 0 first, then start, 2 * start, 4 * start, ...
+    long long int next = lose < 0 ? 0 : (start > lose ? start : lose * 2);
+    while (win < 0) {
+        if (next > MIN_ARMY_LIMIT) return -1;
+        int count = 0;
+        while (count < probes && next <= MIN_ARMY_LIMIT) {
+            values[count++] = next;
+            next = next == 0 ? (start > 0 ? start : 1) : next * 2;
+        }
+        if (!armyProbe(search, values, count)) return -2;
+        for (int p = 0; p < count; p++) {
+            if (search->job.wins[p]) {
+                win = values[p];
+                break;
+            }
+            lose = values[p];
+        }
+    }
+
+    // Narrow (lose, win] with evenly spaced probes
+    while (win - lose > 1) {
+        long long int gap = win - lose;
+        int count = gap - 1 < probes ? (int)(gap - 1) : probes;
+        for (int p = 0; p < count; p++) {
+            values[p] = lose + (long long int)((double)gap * (p + 1) / (count + 1));
+        }
+        if (!armyProbe(search, values, count)) return -2;
+        int firstWin = 0;
+        while (firstWin < count && !search->job.wins[firstWin]) firstWin++;
+        if (firstWin < count) win = values[firstWin];
+        if (firstWin > 0) lose = values[firstWin - 1];
+    }
+    return win;
+}
+
+// Print the smallest winning army of 'side' against the other side of 'base':
+// per unit type with the rest as in the scenario, and for the whole army
+// under 'costs' (cost per unit of each type)
+void runMinimumArmySearch(const BattleContext *base, int side, const double *costs, WorkerPool *pool) {
+    BattleContext start = *base;
+    start.logFile = NULL;
+    start.pool = NULL;
+    start.options.skipQuietRounds = true;
+    if (start.options.decideCheckInterval <= 0) start.options.decideCheckInterval = 16;
+    start.options.finishAfterDecided = false;
+
+    const BattleSide *army = &base->sides[side];
+    int n = army->birimSayisi;
+    ArmySearch search;
+    memset(&search, 0, sizeof(search));
+    search.job.base = &start;
+    search.job.side = side;
+    search.pool = pool;
+    search.parallelProbes = pool != NULL ? pool->threadCount + 1 : 1;
+    if (search.parallelProbes > MIN_ARMY_MAX_PROBES) search.parallelProbes = MIN_ARMY_MAX_PROBES;
+    search.job.counts = (long long int *)calloc((size_t)MIN_ARMY_MAX_PROBES * n + 1, sizeof(long long int));
+    long long int *current = (long long int *)calloc(n + 1, sizeof(long long int));
+    int *order = (int *)calloc(n + 1, sizeof(int));
+    if (search.job.counts == NULL || current == NULL || order == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(search.job.counts);
+        free(current);
+        free(order);
+        return;
+    }
+    double startTime = wallClockSeconds();
+    printf("Minimum army for the %s against the scenario's %s\n", army->cogulEtiket, base->sides[1 - side].cogulEtiket);
+
+    // One unit type at a time
+    printf("Per unit type (other types as in the scenario):\n");
+    search.fixed = army->kalanBirimSayisi;
+    for (int i = 0; i < n; i++) {
+        search.unitIndex = i;
+        long long int minimum = armySearchMinimum(&search, -1, -1, army->kalanBirimSayisi[i]);
+        if (minimum == -2) break;
+        if (minimum < 0) {
+            printf(" - %s: no win with up to %lld\n", army->bilgi[i].isim, MIN_ARMY_LIMIT);
+        } else {
+            printf(" - %s: %lld (scenario %lld)\n", army->bilgi[i].isim, minimum, army->kalanBirimSayisi[i]);
+        }
+    }
+
+    // Whole army: shrink or grow the scenario mix, then trim the costliest types
+    double scenarioCost = 0.0;
+    long long int scaleBase = 1;
+    for (int i = 0; i < n; i++) {
+        scenarioCost += costs[i] * army->kalanBirimSayisi[i];
+        if (army->kalanBirimSayisi[i] > scaleBase) scaleBase = army->kalanBirimSayisi[i];
+    }
+    search.unitIndex = -1;
+    search.scaleBase = scaleBase;
+    long long int scale = battleTotalUnits(army) > 0 ? armySearchMinimum(&search, -1, -1, scaleBase) : -1;
+    printf("Whole army (cost per unit:");
+    for (int i = 0; i < n; i++) printf(" %g", costs[i]);
+    printf("):\n");
+    if (scale == -1) {
+        printf(" no win with the scenario's mix of unit types\n");
+    } else if (scale >= 0) {
+        armyShape(&search, scale, current);
+        for (int i = 0; i < n; i++) order[i] = i;
+        for (int i = 1; i < n; i++) {
+            for (int j = i; j > 0 && costs[order[j]] > costs[order[j - 1]]; j--) {
+                int t = order[j]; order[j] = order[j - 1]; order[j - 1] = t;
+            }
+        }
+        search.fixed = current;
+        for (int k = 0; k < n; k++) {
+            int i = order[k];
+            if (current[i] == 0 || costs[i] <= 0.0) continue;
+            search.unitIndex = i;
+            long long int minimum = armySearchMinimum(&search, -1, current[i], current[i]);
+            if (minimum >= 0) current[i] = minimum;
+        }
+        double cost = 0.0;
+        for (int i = 0; i < n; i++) {
+            cost += costs[i] * current[i];
+            printf(" - %s: %lld\n", army->bilgi[i].isim, current[i]);
+        }
+        printf(" Total cost: %g (scenario army: %g)\n", cost, scenarioCost);
+    }
+    printf("%lld probes, %d at a time, %.3f s\n", search.probesRun, search.parallelProbes, wallClockSeconds() - startTime);
+    free(search.job.counts);
+    free(current);
+    free(order);
+}
+
+// Analytic battle estimator
+// A Lanchester-style model of the same post-effect stats the engine uses.
+// Each side is reduced to a unit count and a kill rate per round:
+//  - CASUALTY_BULK follows the square law, since every hit kills in
+//    proportion to the attacking stack (dN_Y/dt = -rate_X * N_X)
+//  - CASUALTY_ONE_PER_HIT follows the linear law, since a hit kills at most
+//    one unit and the kill rate is capped by the number of hits per round
+// Fatigue is modelled as a geometric decay of attack, which only rescales
+// time. Losses are spread over unit types the way the target cursor does.
+
+typedef struct {
+    BattleOutcome winner;
+    double rounds;            // Estimated rounds until the battle ends
+    double survivors[2];      // Estimated total survivors per side
+    bool reachedMaxRounds;    // Neither side is wiped out before maxRounds
+} BattleEstimate;
+
+// Average per-round fatigue factor on attack, from one real fatigue tick
+static double estimateFatigueDecay(const BattleContext *ctx) {
+    double ratioSum = 0.0;
+    int units = 0;
+    for (int s = 0; s < 2; s++) {
+        const BattleSide *side = &ctx->sides[s];
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (side->kalanBirimSayisi[i] <= 0 || side->saldiri[i] <= 0) continue;
+            int saldiri = side->saldiri[i];
+            int savunma = side->savunma[i];
+            applyFatigueEffect(&saldiri, &savunma, ctx->options.fatiguePercentage);
+            ratioSum += (double)saldiri / side->saldiri[i];
+            units++;
+        }
+    }
+    if (units == 0) return 1.0;
+    return pow(ratioSum / units, 1.0 / ctx->options.fatigueFrequency);
+}
+
+// Expected units of 'defenders' killed per round by 'attackers' at full strength.
+// With one death per hit, hits that kill a whole unit and the 1 damage every
+// hit deals at least do not weaken with fatigue; that share is returned
+// separately in 'steadyKills'.
+static double estimateKillRate(const BattleContext *ctx, const BattleSide *attackers, const BattleSide *defenders, double *steadyKills) {
+    // Hits rotate over the living unit types (plain average of defense),
+    // while health is pooled over all units (count-weighted average)
+    double defense = 0.0, health = 0.0;
+    int targets = 0;
+    for (int j = 0; j < defenders->birimSayisi; j++) {
+        if (defenders->kalanBirimSayisi[j] <= 0) continue;
+        defense += defenders->savunma[j];
+        health += (double)defenders->maksimumSaglik[j] * defenders->kalanBirimSayisi[j];
+        targets++;
+    }
+    if (steadyKills != NULL) *steadyKills = 0.0;
+    if (targets == 0) return 0.0;
+    defense /= targets;
+    health /= (double)battleTotalUnits(defenders);
+
+    double kills = 0.0;
+    for (int i = 0; i < attackers->birimSayisi; i++) {
+        if (attackers->kalanBirimSayisi[i] <= 0) continue;
+        double critFactor = attackers->critThreshold[i] == INT_MAX ? 1.0 : 1.0 + 0.5 / attackers->critThreshold[i];
+        if (ctx->options.randomCrits) {
+            critFactor = 1.0 + 0.5 * (attackers->critChance[i] < 100 ? (attackers->critChance[i] > 0 ? attackers->critChance[i] : 0) : 100) / 100.0;
+        }
+        double attackPower = (double)attackers->saldiri[i] * attackers->kalanBirimSayisi[i] * critFactor;
+        double damage = attackPower - defense;
+        if (damage < attackPower * 0.05) damage = attackPower * 0.05;
+        if (damage < 1.0) damage = 1.0;
+        double hitKills = damage / health;
+        if (ctx->options.casualtyMode == CASUALTY_ONE_PER_HIT && steadyKills != NULL) {
+            if (hitKills >= 1.0) hitKills = 1.0;
+            *steadyKills += hitKills >= 1.0 ? 1.0 : 1.0 / health;
+        }
+        kills += hitKills;
+    }
+    return kills;
+}
+
+// Rounds needed to accumulate 'tau' rounds of full-strength fighting
+static double estimateRoundsForTime(double tau, double decay) {
+    if (decay >= 1.0) return tau;
+    double x = 1.0 - tau * (1.0 - decay);
+    if (x <= 0.0) return INFINITY; // Fatigue wins before the fighting does
+    return log(x) / log(decay);
+}
+
+// Full-strength fighting time available in 'rounds' rounds
+static double estimateTimeForRounds(double rounds, double decay) {
+    if (decay >= 1.0) return rounds;
+    return (1.0 - pow(decay, rounds)) / (1.0 - decay);
+}
+
+// Spread 'losses' over the unit types of a side like the round-robin target
+// cursor does: every living type loses the same amount until it runs out
+static void estimateSpreadLosses(const BattleSide *side, double losses, long long int *survivors) {
+    int alive = 0;
+    double *remaining = (double *)malloc(sizeof(double) * (side->birimSayisi > 0 ? side->birimSayisi : 1));
+    if (remaining == NULL) return;
+    for (int i = 0; i < side->birimSayisi; i++) {
+        remaining[i] = (double)side->kalanBirimSayisi[i];
+        if (remaining[i] > 0) alive++;
+    }
+    while (losses > 1e-9 && alive > 0) {
+        double smallest = INFINITY;
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (remaining[i] > 0 && remaining[i] < smallest) smallest = remaining[i];
+        }
+        double share = losses / alive;
+        if (share > smallest) share = smallest;
+        for (int i = 0; i < side->birimSayisi; i++) {
+            if (remaining[i] <= 0) continue;
+            remaining[i] -= share;
+            losses -= share;
+            if (remaining[i] <= 1e-9) {
+                remaining[i] = 0;
+                alive--;
+            }
+        }
+    }
+    for (int i = 0; i < side->birimSayisi; i++) {
+        survivors[i] = (long long int)llround(remaining[i]);
+    }
+    free(remaining);
+}
+
+// Estimate winner, duration and survivors of a freshly initialised battle.
+// 'survivors' may be NULL; otherwise survivors[s] receives one count per unit type.
+void battleEstimate(const BattleContext *ctx, BattleEstimate *estimate, long long int *survivors[2]) {
+    double units[2] = {
+        (double)battleTotalUnits(&ctx->sides[SIDE_HUMAN]),
+        (double)battleTotalUnits(&ctx->sides[SIDE_ORC])
+    };
+    // killRate[s]: units side s kills per round at full strength
+    double steady[2];
+    double killRate[2] = {
+        estimateKillRate(ctx, &ctx->sides[SIDE_HUMAN], &ctx->sides[SIDE_ORC], &steady[0]),
+        estimateKillRate(ctx, &ctx->sides[SIDE_ORC], &ctx->sides[SIDE_HUMAN], &steady[1])
+    };
+    double decay = estimateFatigueDecay(ctx);
+    double maxTime = estimateTimeForRounds(ctx->options.maxRounds, decay);
+    double left[2];
+    double time;
+
+    if (ctx->options.casualtyMode == CASUALTY_BULK) {
+        // Square law: a[s] is the kill rate per living unit of side s
+        double a[2] = {
+            units[0] > 0 ? killRate[0] / units[0] : 0.0,
+            units[1] > 0 ? killRate[1] / units[1] : 0.0
+        };
+        double strength[2] = { a[0] * units[0] * units[0], a[1] * units[1] * units[1] };
+        int winner = strength[0] >= strength[1] ? 0 : 1;
+        int loser = 1 - winner;
+        double gamma = sqrt(a[0] * a[1]);
+        if (a[winner] <= 0.0) {
+            time = INFINITY; // Nobody can hurt anybody
+        } else if (gamma <= 0.0) {
+            time = units[loser] / (a[winner] * units[winner]);
+        } else {
+            double x = gamma * units[loser] / (a[winner] * units[winner]);
+            time = x < 1.0 ? atanh(x) / gamma : INFINITY;
+        }
+        double t = time < maxTime ? time : maxTime;
+        if (gamma > 0.0) {
+            for (int s = 0; s < 2; s++) {
+                left[s] = units[s] * cosh(gamma * t) - (a[1 - s] / gamma) * units[1 - s] * sinh(gamma * t);
+            }
+        } else {
+            for (int s = 0; s < 2; s++) {
+                left[s] = units[s] - a[1 - s] * units[1 - s] * t;
+            }
+        }
+    } else {
+        // Linear law: side s has killed steady[s] * t + (killRate[s] - steady[s]) * tau(t)
+        // units after t rounds, where only the non-steady part fades with fatigue
+        double wipeRound[2];
+        double maxRounds = ctx->options.maxRounds;
+        for (int s = 0; s < 2; s++) {
+            const int k = 1 - s;
+            double fading = killRate[k] - steady[k];
+            if (steady[k] * maxRounds + fading * maxTime < units[s]) {
+                wipeRound[s] = INFINITY;
+                continue;
+            }
+            // The kill count is monotonic in t, so bisect for the wipe-out round
+            double lo = 0.0, hi = maxRounds;
+            for (int iteration = 0; iteration < 60; iteration++) {
+                double mid = 0.5 * (lo + hi);
+                if (steady[k] * mid + fading * estimateTimeForRounds(mid, decay) < units[s]) lo = mid; else hi = mid;
+            }
+            wipeRound[s] = hi;
+        }
+        double endRound = wipeRound[0] < wipeRound[1] ? wipeRound[0] : wipeRound[1];
+        double t = endRound < maxRounds ? endRound : maxRounds;
+        for (int s = 0; s < 2; s++) {
+            const int k = 1 - s;
+            left[s] = units[s] - (steady[k] * t + (killRate[k] - steady[k]) * estimateTimeForRounds(t, decay));
+        }
+        // Report in full-strength time like the square law does
+        time = endRound < maxRounds ? estimateTimeForRounds(endRound, decay) : INFINITY;
+    }
+
+    for (int s = 0; s < 2; s++) {
+        if (left[s] < 0.0) left[s] = 0.0;
+        estimate->survivors[s] = left[s];
+        if (survivors != NULL && survivors[s] != NULL) {
+            estimateSpreadLosses(&ctx->sides[s], units[s] - left[s], survivors[s]);
+        }
+    }
+    estimate->reachedMaxRounds = !(time < maxTime);
+    if (estimate->reachedMaxRounds) {
+        estimate->rounds = ctx->options.maxRounds;
+    } else {
+        estimate->rounds = ceil(estimateRoundsForTime(time, decay));
+        if (estimate->rounds > ctx->options.maxRounds) estimate->rounds = ctx->options.maxRounds;
+        if (estimate->rounds < 1) estimate->rounds = 1;
+    }
+    if (left[0] > left[1] + 0.5) {
+        estimate->winner = BATTLE_HUMANS_WIN;
+    } else if (left[1] > left[0] + 0.5) {
+        estimate->winner = BATTLE_ORCS_WIN;
+    } else {
+        estimate->winner = BATTLE_DRAW;
+    }
+}
+
+// Print the estimate for one battle
+void printBattleEstimate(const BattleContext *ctx) {
+    long long int *survivors[2];
+    survivors[0] = (long long int *)calloc(ctx->sides[0].birimSayisi + 1, sizeof(long long int));
+    survivors[1] = (long long int *)calloc(ctx->sides[1].birimSayisi + 1, sizeof(long long int));
+    if (survivors[0] == NULL || survivors[1] == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(survivors[0]);
+        free(survivors[1]);
+        return;
+    }
+
+    BattleEstimate estimate;
+    clock_t start = clock();
+    battleEstimate(ctx, &estimate, survivors);
+    double elapsedMicroseconds = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC;
+
+    printf("Battle estimate (%s law)\n", ctx->options.casualtyMode == CASUALTY_BULK ? "square" : "linear");
+    printf("Rounds: %.0f%s\n", estimate.rounds, estimate.reachedMaxRounds ? " (maxRounds reached)" : "");
+    printf("Winner: %s\n", battleOutcomeName(estimate.winner));
+    for (int s = 0; s < 2; s++) {
+        printf("%s: %.0f units remaining\n", ctx->sides[s].cogulEtiket, estimate.survivors[s]);
+        for (int i = 0; i < ctx->sides[s].birimSayisi; i++) {
+            printf(" - %s: %lld units remaining\n", ctx->sides[s].bilgi[i].isim, survivors[s][i]);
+        }
+    }
+    printf("Estimate time: %.1f us\n", elapsedMicroseconds);
+    free(survivors[0]);
+    free(survivors[1]);
+}
+
+// Compare the estimator with the exact engine on a calibration set: the
+// given battle with each side's unit counts scaled independently
+void runEstimatorCalibration(const BattleContext *base) {
+    static const double scales[] = { 0.25, 0.5, 1.0, 2.0, 4.0 };
+    const int scaleCount = (int)(sizeof(scales) / sizeof(scales[0]));
+    int cases = 0, winnerMatches = 0;
+    double roundsError = 0.0, survivorsError = 0.0;
+
+    printf("Estimator calibration (%s casualties)\n", base->options.casualtyMode == CASUALTY_BULK ? "bulk" : "single");
+    printf("%6s %6s | %-7s %-7s | %7s %7s | %10s %10s\n", "xHuman", "xOrc", "exact", "est.", "rounds", "est.", "survivors", "est.");
+    for (int h = 0; h < scaleCount; h++) {
+        for (int o = 0; o < scaleCount; o++) {
+            const double scale[2] = { scales[h], scales[o] };
+            BattleContext exact;
+            if (!battleClone(&exact, base)) {
+                return;
+            }
+            exact.logFile = NULL;
+            exact.options.decideCheckInterval = 0;
+            battleScaleCounts(&exact, SIDE_HUMAN, scale[0]);
+            battleScaleCounts(&exact, SIDE_ORC, scale[1]);
+
+            BattleEstimate estimate;
+            battleEstimate(&exact, &estimate, NULL);
+            battleRun(&exact);
+
+            int winnerSide = exact.outcome == BATTLE_ORCS_WIN ? SIDE_ORC : SIDE_HUMAN;
+            double exactSurvivors = (double)battleTotalUnits(&exact.sides[winnerSide]);
+            double estimatedSurvivors = estimate.survivors[winnerSide];
+            printf("%6.2f %6.2f | %-7s %-7s | %7d %7.0f | %10.0f %10.0f\n", scale[0], scale[1],
+                   battleOutcomeName(exact.outcome), battleOutcomeName(estimate.winner),
+                   exact.roundsPlayed, estimate.rounds, exactSurvivors, estimatedSurvivors);
+
+            cases++;
+            if (estimate.winner == exact.outcome) winnerMatches++;
+            roundsError += fabs(estimate.rounds - exact.roundsPlayed) / exact.roundsPlayed;
+            survivorsError += fabs(estimatedSurvivors - exactSurvivors) / (exactSurvivors > 1.0 ? exactSurvivors : 1.0);
+            battleDestroy(&exact);
+        }
+    }
+    printf("Winner agreement: %d/%d (%.1f%%)\n", winnerMatches, cases, 100.0 * winnerMatches / cases);
+    printf("Mean relative rounds error: %.1f%%\n", 100.0 * roundsError / cases);
+    printf("Mean relative survivors error (exact winner's side): %.1f%%\n", 100.0 * survivorsError / cases);
+}
+
+// Scenario setup
+// The four data files are compiled once into GameTables; parseScenarioSetup,
+// applyLoadout and setupBattle turn one scenario document into a battle with
+// every effect applied. Nothing is kept in globals, so several scenarios can
+// be set up at the same time.
+
+// Data files, by GameData bit
+enum {
+    GAME_DATA_UNIT_TYPES = 1 << 0,
+    GAME_DATA_HEROES = 1 << 1,
+    GAME_DATA_CREATURES = 1 << 2,
+    GAME_DATA_RESEARCH = 1 << 3,
+    GAME_DATA_ALL = 0xF
+};
+#define GAME_DATA_FILES 4
+
+// Unit registry
+// Every faction in unit_types.json and every unit type in a faction gets a
+// dense id in file order, so the unit types of one faction have consecutive
+// ids. Keys are resolved through open-addressing hash tables. Besides its
+// unit types, a faction may list "etiket" and "cogul_etiket" for the log, and
+// a unit type may have an "isim" to show. The original two factions and
+// their units have built-in ones.
+
+#define UNIT_REGISTRY_MAX_FACTIONS 8
+#define UNIT_REGISTRY_MAX_UNITS 128
+#define UNIT_REGISTRY_UNIT_SLOTS 256      // Power of two, at least twice UNIT_REGISTRY_MAX_UNITS
+#define UNIT_REGISTRY_FACTION_SLOTS 16    // Power of two, at least twice UNIT_REGISTRY_MAX_FACTIONS
+
+typedef struct {
+    char key[50];            // Key in unit_types.json and scenarios ("piyadeler")
+    char isim[50];           // Name in the log and on screen
+    int faction;
+    unsigned char renk[4];   // Drawing color (RGBA)
+} UnitType;
+
+typedef struct {
+    char key[50];            // Key in the data files and scenarios ("insan_imparatorlugu")
+    char etiket[24];         // Name used in log lines ("Human")
+    char cogulEtiket[24];    // Plural name ("Humans")
+    int firstUnit;           // Unit types firstUnit .. firstUnit + unitCount - 1
+    int unitCount;
+} Faction;
+
+typedef struct {
+    int factionCount;
+    int unitCount;
+    Faction factions[UNIT_REGISTRY_MAX_FACTIONS];
+    UnitType units[UNIT_REGISTRY_MAX_UNITS];
+    short unitSlots[UNIT_REGISTRY_UNIT_SLOTS];       // Unit id + 1, 0 = empty
+    short factionSlots[UNIT_REGISTRY_FACTION_SLOTS]; // Faction id + 1, 0 = empty
+} UnitRegistry;
+
+// FNV-1a hash of a key
+static unsigned int unitRegistryHash(const char *key) {
+    unsigned int hash = 2166136261u;
+    for (; *key != '\0'; key++) {
+        hash = (hash ^ (unsigned char)*key) * 16777619u;
+    }
+    return hash;
+}
+
+// Id of faction 'key', or -1
+int unitRegistryFaction(const UnitRegistry *registry, const char *key) {
+    unsigned int mask = UNIT_REGISTRY_FACTION_SLOTS - 1;
+    for (unsigned int slot = unitRegistryHash(key) & mask; registry->factionSlots[slot] != 0; slot = (slot + 1) & mask) {
+        int id = registry->factionSlots[slot] - 1;
+        if (strcmp(registry->factions[id].key, key) == 0) return id;
+    }
+    return -1;
+}
+
+// Id of unit type 'key' of faction 'faction' (-1 = of any faction, the first
+// registered wins), or -1
+int unitRegistryUnit(const UnitRegistry *registry, int faction, const char *key) {
+    unsigned int mask = UNIT_REGISTRY_UNIT_SLOTS - 1;
+    for (unsigned int slot = unitRegistryHash(key) & mask; registry->unitSlots[slot] != 0; slot = (slot + 1) & mask) {
+        int id = registry->unitSlots[slot] - 1;
+        if ((faction < 0 || registry->units[id].faction == faction) && strcmp(registry->units[id].key, key) == 0) return id;
+    }
+    return -1;
+}
+
+static void unitRegistryInsert(short *slots, unsigned int slotCount, const char *key, int id) {
+    unsigned int slot = unitRegistryHash(key) & (slotCount - 1);
+    while (slots[slot] != 0) slot = (slot + 1) & (slotCount - 1);
+    slots[slot] = (short)(id + 1);
+}
+
+// Unit stats by unit id, before or after effects
+typedef struct {
+    int saldiri[UNIT_REGISTRY_MAX_UNITS];
+    int savunma[UNIT_REGISTRY_MAX_UNITS];
+    int saglik[UNIT_REGISTRY_MAX_UNITS];
+    int kritikSans[UNIT_REGISTRY_MAX_UNITS];
+} ArmyStats;
+
+// Factions, unit types and base stats from unit_types.json. False if there
+// are more factions or unit types than the registry holds, or if a unit type
+// has no positive saglik or a negative stat.
+bool compileUnitRegistry(const JsonIndex *unitTypes, UnitRegistry *registry, ArmyStats *stats) {
+    static const char *const builtinFactions[2][3] = {
+        { "insan_imparatorlugu", "Human", "Humans" }, { "ork_legi", "Orc", "Orcs" }
+    };
+    static const char *const builtinUnits[8][2] = {
+        { "piyadeler", "Piyadeler" }, { "okcular", "Okular" }, { "suvariler", "Svariler" },
+        { "kusatma_makineleri", "Kuatma Makineleri" }, { "ork_dovusculeri", "Ork Dvleri" },
+        { "mizrakcilar", "Mzraklar" }, { "varg_binicileri", "Varg Binicileri" }, { "troller", "Troller" }
+    };
+    const Color builtinColors[8] = { ORANGE, DARKBLUE, RED, DARKGREEN, DARKGRAY, MAROON, BROWN, DARKBLUE };
+    const Color palette[8] = { GOLD, PURPLE, DARKPURPLE, LIME, SKYBLUE, BEIGE, PINK, VIOLET };
+    memset(registry, 0, sizeof(*registry));
+    memset(stats, 0, sizeof(*stats));
+
+    for (int section = jsonNextMember(unitTypes, 0, -1); section >= 0; section = jsonNextMember(unitTypes, 0, section)) {
+        if (unitTypes->tokens[section + 1].type != JSON_OBJECT) continue;
+        char key[50] = "";
+        jsonString(unitTypes, section, key, sizeof(key));
+        if (unitRegistryFaction(registry, key) >= 0) continue;
+        if (registry->factionCount == UNIT_REGISTRY_MAX_FACTIONS) {
+            fprintf(stderr, "More than %d factions in unit_types.json.\n", UNIT_REGISTRY_MAX_FACTIONS);
+            return false;
+        }
+        int f = registry->factionCount++;
+        Faction *faction = &registry->factions[f];
+        snprintf(faction->key, sizeof(faction->key), "%s", key);
+        // Labels default to the key, cut to what a log line holds
+        snprintf(faction->etiket, sizeof(faction->etiket), "%.23s", key);
+        snprintf(faction->cogulEtiket, sizeof(faction->cogulEtiket), "%.23s", key);
+        for (int b = 0; b < 2; b++) {
+            if (strcmp(key, builtinFactions[b][0]) == 0) {
+                snprintf(faction->etiket, sizeof(faction->etiket), "%s", builtinFactions[b][1]);
+                snprintf(faction->cogulEtiket, sizeof(faction->cogulEtiket), "%s", builtinFactions[b][2]);
+            }
+        }
+        jsonString(unitTypes, jsonFind(unitTypes, section + 1, "etiket"), faction->etiket, sizeof(faction->etiket));
+        jsonString(unitTypes, jsonFind(unitTypes, section + 1, "cogul_etiket"), faction->cogulEtiket, sizeof(faction->cogulEtiket));
+        unitRegistryInsert(registry->factionSlots, UNIT_REGISTRY_FACTION_SLOTS, faction->key, f);
+
+        faction->firstUnit = registry->unitCount;
+        for (int member = jsonNextMember(unitTypes, section + 1, -1); member >= 0; member = jsonNextMember(unitTypes, section + 1, member)) {
+            int value = member + 1;
+            if (unitTypes->tokens[value].type != JSON_OBJECT) continue;
+            jsonString(unitTypes, member, key, sizeof(key));
+            if (unitRegistryUnit(registry, f, key) >= 0) continue;
+            if (registry->unitCount == UNIT_REGISTRY_MAX_UNITS) {
+                fprintf(stderr, "More than %d unit types in unit_types.json.\n", UNIT_REGISTRY_MAX_UNITS);
+                return false;
+            }
+            int u = registry->unitCount++;
+            UnitType *unit = &registry->units[u];
+            Color renk = palette[u % 8];
+            snprintf(unit->key, sizeof(unit->key), "%s", key);
+            snprintf(unit->isim, sizeof(unit->isim), "%s", key);
+            for (int b = 0; b < 8; b++) {
+                if (strcmp(key, builtinUnits[b][0]) == 0) {
+                    snprintf(unit->isim, sizeof(unit->isim), "%s", builtinUnits[b][1]);
+                    renk = builtinColors[b];
+                }
+            }
+            jsonString(unitTypes, jsonFind(unitTypes, value, "isim"), unit->isim, sizeof(unit->isim));
+            unit->faction = f;
+            unit->renk[0] = renk.r;
+            unit->renk[1] = renk.g;
+            unit->renk[2] = renk.b;
+            unit->renk[3] = renk.a;
+            unitRegistryInsert(registry->unitSlots, UNIT_REGISTRY_UNIT_SLOTS, unit->key, u);
+
+            stats->saldiri[u] = jsonIntMember(unitTypes, value, "saldiri");
+            stats->savunma[u] = jsonIntMember(unitTypes, value, "savunma");
+            stats->saglik[u] = jsonIntMember(unitTypes, value, "saglik");
+            stats->kritikSans[u] = jsonIntMember(unitTypes, value, "kritik_sans");
+            if (stats->saglik[u] <= 0 || stats->saldiri[u] < 0 || stats->savunma[u] < 0 || stats->kritikSans[u] < 0) {
+                fprintf(stderr, "Invalid stats for %s in unit_types.json: saglik must be positive, "
+                                "saldiri, savunma and kritik_sans must not be negative.\n", unit->key);
+                return false;
+            }
+        }
+        faction->unitCount = registry->unitCount - faction->firstUnit;
+    }
+    return true;
+}
+
+// Stat a hero or creature changes
+typedef enum {
+    ETKI_YOK,           // unknown bonus type: no effect
+    ETKI_SALDIRI,
+    ETKI_SAVUNMA,
+    ETKI_KRITIK_SANS
+} EtkiTuru;
+
+// One change a hero or creature makes to a run of unit types
+typedef struct {
+    unsigned short firstUnit;     // Unit ids firstUnit .. firstUnit + unitCount - 1
+    unsigned short unitCount;
+    unsigned char stat;           // EtkiTuru
+    unsigned char multiplicative; // stat * (100 + value) / 100 if set, else stat + value
+    unsigned short reserved;
+    int value;
+} EffectRule;
+
+// Most rules of one hero or creature
+#define EFFECT_MAX_RULES 8
+
+// One hero or creature, compiled from heroes.json / creatures.json
+typedef struct {
+    char isim[50];
+    int ruleCount;
+    EffectRule rules[EFFECT_MAX_RULES];
+} LoadoutEffect;
+
+// Most heroes or creatures of one faction
+#define GAME_DATA_MAX_EFFECTS 32
+
+typedef struct {
+    int count;
+    LoadoutEffect effects[GAME_DATA_MAX_EFFECTS];
+} LoadoutEffectList;
+
+// Research lines, by index in ScenarioSetup.researchLevel and ResearchTable
+enum { RESEARCH_SAVUNMA, RESEARCH_SALDIRI, RESEARCH_LINES };
+static const char *const researchKeys[RESEARCH_LINES] = { "savunma_ustaligi", "saldiri_gelistirmesi" };
+
+// Highest research level a ResearchTable holds
+#define RESEARCH_MAX_LEVEL 15
+
+// Research of one faction, expanded from research.json: for every line and
+// level the factor, in percent, that the line's stat of every unit is
+// multiplied by. Level 0 is 100. A level the file does not list keeps the
+// factor of the level below, and levels above maxLevel use maxLevel's.
+typedef struct {
+    int maxLevel[RESEARCH_LINES];
+    int multiplier[RESEARCH_LINES][RESEARCH_MAX_LEVEL + 1];
+} ResearchTable;
+
+// Everything the simulator takes from the data files, in a fixed layout
+// without pointers, so it can be stored as is in a data bundle
+typedef struct {
+    UnitRegistry registry;                                    // unit_types.json: factions and unit types
+    ArmyStats baseStats;                                      // unit_types.json, by unit id, before any effect
+    LoadoutEffectList heroes[UNIT_REGISTRY_MAX_FACTIONS];     // heroes.json, by faction id
+    LoadoutEffectList creatures[UNIT_REGISTRY_MAX_FACTIONS];  // creatures.json, by faction id
+    ResearchTable research[UNIT_REGISTRY_MAX_FACTIONS];       // research.json, by faction id
+} GameTables;
+
+typedef struct {
+    const GameTables *tables; // What the simulator reads: the bundle's tables or 'compiled'
+    GameTables *compiled;     // Tables compiled from the JSON files (NULL with a bundle)
+    MappedFile bundle;        // Mapped data bundle, if one was used
+    unsigned int loaded;      // GAME_DATA_* bits of the files in 'tables'; the others stay empty
+} GameData;
+
+// EtkiTuru of a bonus_turu / etki_turu value
+int etkiTuruFromString(const char *tur) {
+    if (strcmp(tur, "saldiri") == 0) return ETKI_SALDIRI;
+    if (strcmp(tur, "savunma") == 0) return ETKI_SAVUNMA;
+    if (strcmp(tur, "kritik_sans") == 0) return ETKI_KRITIK_SANS;
+    return ETKI_YOK;
+}
+
+// Migration fallback, to be removed after one release: the stock heroes.json
+// and creatures.json predate etkiledigi_birim, so their entries get the units
+// the game used to hard-code, by faction, name and bonus type. New entries
+// name their units with etkiledigi_birim instead of being added here.
+typedef struct {
+    const char *faction;
+    const char *isim;
+    const char *tur;
+    const char *target;      // Unit key or "tum_birimler"
+} BuiltinEffectTarget;
+
+static const BuiltinEffectTarget builtinHeroTargets[] = {
+    { "insan_imparatorlugu", "Alparslan", "saldiri", "piyadeler" },
+    { "insan_imparatorlugu", "Fatih_Sultan_Mehmet", "saldiri", "kusatma_makineleri" },
+    { "insan_imparatorlugu", "Tugrul_Bey", "saldiri", "okcular" },
+    { "insan_imparatorlugu", "Mete_Han", "savunma", "okcular" },
+    { "insan_imparatorlugu", "Yavuz_Sultan_Selim", "kritik_sans", "suvariler" },
+    { "ork_legi", "Goruk_Vahsi", "saldiri", "ork_dovusculeri" },
+    { "ork_legi", "Thruk_Kemikkiran", "savunma", "troller" },
+    { "ork_legi", "Ugar_Zalim", "savunma", "tum_birimler" },
+    { "ork_legi", "Vrog_Kafakiran", "kritik_sans", "varg_binicileri" },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const BuiltinEffectTarget builtinCreatureTargets[] = {
+    { "insan_imparatorlugu", "Ejderha", "saldiri", "tum_birimler" },
+    { "insan_imparatorlugu", "Ejderha", "kritik_sans", "suvariler" },
+    { "insan_imparatorlugu", "Tepegoz", "saldiri", "okcular" },
+    { "insan_imparatorlugu", "Karakurt", "savunma", "okcular" },
+    { "ork_legi", "Kara_Troll", "saldiri", "troller" },
+    { "ork_legi", "Kara_Troll", "kritik_sans", "troller" },
+    { "ork_legi", "Golge_Kurtlari", "savunma", "varg_binicileri" },
+    { NULL, NULL, NULL, NULL }
+};
+
+// Rules of one hero or creature of faction 'faction': the stat and value of
+// its type and value keys, applied to the units named by etkiledigi_birim.
+// That is a unit key of its own faction (or, failing that, of any other
+// faction) or "tum_birimler" for every unit of its own faction. Without
+// etkiledigi_birim the target comes from the migration table 'builtins'; an
+// entry that is not there has no effect. Percentages multiply saldiri and savunma; kritik_sans
+// is raised by the value itself.
+static void compileEffectRules(const JsonIndex *index, int entry, const UnitRegistry *registry, int faction,
+                               const char *typeKey, const char *valueKey, const BuiltinEffectTarget *builtins,
+                               LoadoutEffect *effect) {
+    char tur[20] = "";
+    char target[50] = "";
+    jsonString(index, jsonFind(index, entry, typeKey), tur, sizeof(tur));
+    int stat = etkiTuruFromString(tur);
+    int value = jsonIntMember(index, entry, valueKey);
+    effect->ruleCount = 0;
+    if (stat == ETKI_YOK) return;
+
+    int targetKey = jsonFind(index, entry, "etkiledigi_birim");
+    if (targetKey >= 0) {
+        jsonString(index, targetKey, target, sizeof(target));
+    } else {
+        const BuiltinEffectTarget *builtin = builtins;
+        while (builtin->isim != NULL && (strcmp(builtin->faction, registry->factions[faction].key) != 0 ||
+                                         strcmp(builtin->isim, effect->isim) != 0 || strcmp(builtin->tur, tur) != 0)) {
+            builtin++;
+        }
+        if (builtin->isim == NULL) {
+            fprintf(stderr, "No etkiledigi_birim for %s; it has no effect.\n", effect->isim);
+            return;
+        }
+        snprintf(target, sizeof(target), "%s", builtin->target);
+    }
+
+    int firstUnit, unitCount = 1;
+    if (strcmp(target, "tum_birimler") == 0) {
+        firstUnit = registry->factions[faction].firstUnit;
+        unitCount = registry->factions[faction].unitCount;
+    } else {
+        firstUnit = unitRegistryUnit(registry, faction, target);
+        if (firstUnit < 0) firstUnit = unitRegistryUnit(registry, -1, target);
+        if (firstUnit < 0) {
+            fprintf(stderr, "Unknown etkiledigi_birim \"%s\" for %s; it has no effect.\n", target, effect->isim);
+            return;
+        }
+    }
+    EffectRule *rule = &effect->rules[effect->ruleCount++];
+    rule->firstUnit = (unsigned short)firstUnit;
+    rule->unitCount = (unsigned short)unitCount;
+    rule->stat = (unsigned char)stat;
+    rule->multiplicative = stat != ETKI_KRITIK_SANS;
+    rule->value = value;
+}
+
+// Heroes or creatures of every faction from heroes.json / creatures.json; the
+// type and value keys and the built-in targets differ between the two files.
+// Sections of factions unit_types.json does not have are ignored. False if a
+// faction has more entries than a LoadoutEffectList holds.
+bool compileLoadoutEffects(const JsonIndex *index, const UnitRegistry *registry, const char *typeKey, const char *valueKey,
+                           const BuiltinEffectTarget *builtins, LoadoutEffectList lists[UNIT_REGISTRY_MAX_FACTIONS]) {
+    for (int f = 0; f < registry->factionCount; f++) {
+        LoadoutEffectList *list = &lists[f];
+        int section = jsonFind(index, 0, registry->factions[f].key);
+        list->count = 0;
+        if (section < 0 || index->tokens[section].type != JSON_OBJECT) continue;
+        for (int member = jsonNextMember(index, section, -1); member >= 0; member = jsonNextMember(index, section, member)) {
+            if (list->count == GAME_DATA_MAX_EFFECTS) {
+                fprintf(stderr, "More than %d entries for %s.\n", GAME_DATA_MAX_EFFECTS, registry->factions[f].key);
+                return false;
+            }
+            LoadoutEffect *effect = &list->effects[list->count++];
+            jsonString(index, member, effect->isim, sizeof(effect->isim));
+            compileEffectRules(index, member + 1, registry, f, typeKey, valueKey, builtins, effect);
+        }
+    }
+    return true;
+}
+
+// Research tables of every faction from research.json. Its lines apply to
+// every faction, except where a faction has a section of its own (keyed as in
+// the scenario) with that line in it. Every seviye_N entry gives the total
+// bonus "deger" in percent at level N. False if a level is above RESEARCH_MAX_LEVEL.
+bool compileResearch(const JsonIndex *research, const UnitRegistry *registry, ResearchTable tables[UNIT_REGISTRY_MAX_FACTIONS]) {
+    for (int f = 0; f < registry->factionCount; f++) {
+        ResearchTable *table = &tables[f];
+        int own = jsonFind(research, 0, registry->factions[f].key);
+        memset(table, 0, sizeof(*table));
+        for (int line = 0; line < RESEARCH_LINES; line++) {
+            int section = own >= 0 ? jsonFind(research, own, researchKeys[line]) : -1;
+            if (section < 0) section = jsonFind(research, 0, researchKeys[line]);
+            bool listed[RESEARCH_MAX_LEVEL + 1] = { false };
+            int percent[RESEARCH_MAX_LEVEL + 1] = { 0 };
+            if (section >= 0 && research->tokens[section].type == JSON_OBJECT) {
+                for (int member = jsonNextMember(research, section, -1); member >= 0; member = jsonNextMember(research, section, member)) {
+                    char key[50] = "";
+                    jsonString(research, member, key, sizeof(key));
+                    int level = strncmp(key, "seviye_", 7) == 0 ? atoi(key + 7) : 0;
+                    if (level < 1) continue;
+                    if (level > RESEARCH_MAX_LEVEL) {
+                        fprintf(stderr, "Research level %s of %s is above %d.\n", key, researchKeys[line], RESEARCH_MAX_LEVEL);
+                        return false;
+                    }
+                    listed[level] = true;
+                    percent[level] = jsonIntMember(research, member + 1, "deger");
+                    if (level > table->maxLevel[line]) table->maxLevel[line] = level;
+                }
+            }
+            table->multiplier[line][0] = 100;
+            for (int level = 1; level <= RESEARCH_MAX_LEVEL; level++) {
+                table->multiplier[line][level] = listed[level] ? 100 + percent[level] : table->multiplier[line][level - 1];
+            }
+        }
+    }
+    return true;
+}
+
+// Hero or creature 'name' of 'list'; NULL for an empty or unknown name
+const LoadoutEffect *findLoadoutEffect(const LoadoutEffectList *list, const char *name) {
+    if (name[0] == '\0') return NULL;
+    for (int e = 0; e < list->count; e++) {
+        if (strcmp(list->effects[e].isim, name) == 0) return &list->effects[e];
+    }
+    return NULL;
+}
+
+// Apply the rules of one hero or creature ('effect' NULL = none) to 'stats'
+void applyEffectRules(const LoadoutEffect *effect, ArmyStats *stats) {
+    if (effect == NULL) return;
+    for (int r = 0; r < effect->ruleCount; r++) {
+        const EffectRule *rule = &effect->rules[r];
+        int *field = rule->stat == ETKI_SALDIRI ? stats->saldiri : rule->stat == ETKI_SAVUNMA ? stats->savunma : stats->kritikSans;
+        for (int u = rule->firstUnit; u < rule->firstUnit + rule->unitCount; u++) {
+            field[u] = rule->multiplicative ? field[u] * (100 + rule->value) / 100 : field[u] + rule->value;
+        }
+    }
+}
+
+// Apply the research levels 'levels' (one per line) of 'faction' to 'stats'
+void applyResearch(const ResearchTable *research, const int levels[RESEARCH_LINES], const Faction *faction, ArmyStats *stats) {
+    for (int line = 0; line < RESEARCH_LINES; line++) {
+        int level = levels[line] > research->maxLevel[line] ? research->maxLevel[line] : levels[line];
+        if (level <= 0) continue;  // also when research.json was not loaded
+        int factor = research->multiplier[line][level];
+        int *field = line == RESEARCH_SAVUNMA ? stats->savunma : stats->saldiri;
+        for (int u = faction->firstUnit; u < faction->firstUnit + faction->unitCount; u++) {
+            field[u] = field[u] * factor / 100;
+        }
+    }
+}
+
+void freeGameData(GameData *data) {
+    unmapFile(&data->bundle);
+    free(data->compiled);
+    memset(data, 0, sizeof(*data));
+}
+
+static const char *const gameDataPaths[GAME_DATA_FILES] = {
+    "C:\\json\\unit_types.json", "C:\\json\\heroes.json", "C:\\json\\creatures.json", "C:\\json\\research.json"
+};
+static const char *const gameDataNames[GAME_DATA_FILES] = { "unit types", "heroes", "creatures", "research" };
+
+// Data bundle
+// --compile-data stores the GameTables compiled from the four JSON files in
+// one binary file, along with the size and write time of every source file.
+// Later runs map the bundle and read the tables in place, so no JSON is read,
+// tokenized or matched by name. Once a source file no longer matches what
+// was recorded, the bundle is ignored and the JSON files are read as before.
+// Like checkpoints, a bundle is meant for the build that wrote it: the
+// tables are stored in the machine's byte order and the build's layout.
+
+#define DATA_BUNDLE_MAGIC "SDB1"
+#define DATA_BUNDLE_VERSION 4
+#define DATA_BUNDLE_DEFAULT_PATH "C:\\json\\game_data.bin"
+
+// Identity of a source file at compile time
+typedef struct {
+    unsigned long long int size;
+    unsigned long long int writeTime;
+} DataFileStamp;
+
+typedef struct {
+    char magic[4];
+    int version;
+    int tablesSize;             // sizeof(GameTables) of the build that wrote the bundle
+    int reserved;
+    DataFileStamp sources[GAME_DATA_FILES];
+    GameTables tables;
+} DataBundle;
+
+// Size and last write time of 'path'; false if it cannot be read
+bool dataFileStamp(const char *path, DataFileStamp *stamp) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    memset(stamp, 0, sizeof(*stamp));
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) return false;
+    stamp->size = ((unsigned long long int)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    stamp->writeTime = ((unsigned long long int)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+                       attributes.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+// Use the tables of the bundle at 'path' if it is there and up to date with
+// every source file. A missing bundle is not reported; one that is out of
+// date or damaged is, and false sends the caller to the JSON files.
+bool dataBundleOpen(GameData *data, const char *path) {
+    if (GetFileAttributesA(path) == INVALID_FILE_ATTRIBUTES) return false;
+    MappedFile file;
+    bool ok = mapFile(&file, path);
+    const DataBundle *bundle = (const DataBundle *)file.data;
+    ok = ok && file.size == sizeof(DataBundle) && memcmp(bundle->magic, DATA_BUNDLE_MAGIC, 4) == 0 &&
+         bundle->version == DATA_BUNDLE_VERSION && bundle->tablesSize == (int)sizeof(GameTables);
+    if (!ok) {
+        fprintf(stderr, "Data bundle %s is damaged or from another version; reading the JSON files.\n", path);
+        unmapFile(&file);
+        return false;
+    }
+    for (int f = 0; f < GAME_DATA_FILES; f++) {
+        DataFileStamp stamp;
+        if (!dataFileStamp(gameDataPaths[f], &stamp) || stamp.size != bundle->sources[f].size ||
+            stamp.writeTime != bundle->sources[f].writeTime) {
+            fprintf(stderr, "Data bundle %s is out of date (%s changed); reading the JSON files.\n", path, gameDataPaths[f]);
+            unmapFile(&file);
+            return false;
+        }
+    }
+    data->bundle = file;
+    data->tables = &bundle->tables;
+    data->loaded = GAME_DATA_ALL;
+    return true;
+}
+
+// Game data loading
+// A usable data bundle supplies all tables at once. Otherwise each data file
+// is mapped and indexed on a thread of its own, so the files load at the same
+// time and, with gameDataLoadStart before a download, while the scenario is
+// still on its way. The indexes are compiled once every thread is done, unit
+// types first, since the other files name factions and units of the registry.
+// Only the files asked for are read.
+
+typedef struct {
+    int file;
+    bool started;
+    bool opened;
+    bool parsed;
+    MappedFile mapped;       // Kept until the index is compiled
+    JsonIndex index;
+} GameDataFileJob;
+
+typedef struct {
+    GameData *data;
+    GameDataFileJob jobs[GAME_DATA_FILES];
+    HANDLE threads[GAME_DATA_FILES];
+} GameDataLoader;
+
+// Map one data file and index it
+static DWORD WINAPI gameDataLoadFile(LPVOID param) {
+    GameDataFileJob *job = (GameDataFileJob *)param;
+    job->opened = mapFile(&job->mapped, gameDataPaths[job->file]);
+    if (job->opened) {
+        job->parsed = jsonIndexBuild(&job->index, job->mapped.data, job->mapped.size);
+    }
+    return 0;
+}
+
+// Compile the index of one data file into its part of the tables
+static bool gameDataCompileFile(GameDataFileJob *job, GameTables *tables) {
+    switch (job->file) {
+        case 0: return compileUnitRegistry(&job->index, &tables->registry, &tables->baseStats);
+        case 1: return compileLoadoutEffects(&job->index, &tables->registry, "bonus_turu", "bonus_degeri", builtinHeroTargets, tables->heroes);
+        case 2: return compileLoadoutEffects(&job->index, &tables->registry, "etki_turu", "etki_degeri", builtinCreatureTargets, tables->creatures);
+        default: return compileResearch(&job->index, &tables->registry, tables->research);
+    }
+}
+
+// Start reading the files in 'needs' (GAME_DATA_* bits); unit types are
+// always read. A current bundle at 'bundlePath' (NULL = none) replaces them all.
+void gameDataLoadStart(GameDataLoader *loader, GameData *data, unsigned int needs, const char *bundlePath) {
+    memset(data, 0, sizeof(*data));
+    memset(loader, 0, sizeof(*loader));
+    loader->data = data;
+    if (bundlePath != NULL && dataBundleOpen(data, bundlePath)) return;
+    data->compiled = (GameTables *)calloc(1, sizeof(GameTables));
+    if (data->compiled == NULL) return;
+    data->tables = data->compiled;
+    data->loaded = needs | GAME_DATA_UNIT_TYPES;
+    for (int f = 0; f < GAME_DATA_FILES; f++) {
+        if (!(data->loaded & (1u << f))) continue;
+        loader->jobs[f].file = f;
+        loader->jobs[f].started = true;
+        loader->threads[f] = CreateThread(NULL, 0, gameDataLoadFile, &loader->jobs[f], 0, NULL);
+        if (loader->threads[f] == NULL) {
+            gameDataLoadFile(&loader->jobs[f]);
+        }
+    }
+}
+
+// Wait for gameDataLoadStart and compile what it read; reports the first file
+// that failed and frees everything in that case
+bool gameDataLoadFinish(GameDataLoader *loader) {
+    GameData *data = loader->data;
+    for (int f = 0; f < GAME_DATA_FILES; f++) {
+        if (loader->threads[f] != NULL) {
+            WaitForSingleObject(loader->threads[f], INFINITE);
+            CloseHandle(loader->threads[f]);
+        }
+    }
+    if (data->tables == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return false;
+    }
+    bool ok = true;
+    for (int f = 0; f < GAME_DATA_FILES; f++) {
+        GameDataFileJob *job = &loader->jobs[f];
+        if (!job->started) continue;
+        bool compiled = ok && job->parsed && gameDataCompileFile(job, data->compiled);
+        if (ok && !compiled) {
+            if (!job->opened) {
+                fprintf(stderr, "Cannot open file: %s\n", gameDataPaths[f]);
+            }
+            fprintf(stderr, "Failed to %s %s JSON.\n", job->opened ? "parse" : "read", gameDataNames[f]);
+            ok = false;
+        }
+        if (job->parsed) jsonIndexFree(&job->index);
+        unmapFile(&job->mapped);
+    }
+    if (!ok) freeGameData(data);
+    return ok;
+}
+
+// Read the data files in 'needs' (or the bundle at 'bundlePath'); reports the file that failed
+bool loadGameData(GameData *data, unsigned int needs, const char *bundlePath) {
+    GameDataLoader loader;
+    gameDataLoadStart(&loader, data, needs, bundlePath);
+    return gameDataLoadFinish(&loader);
+}
+
+// Compile the four data files into a bundle at 'path' (through a temporary file)
+bool dataBundleCompile(const char *path) {
+    DataBundle *bundle = (DataBundle *)calloc(1, sizeof(DataBundle));
+    if (bundle == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return false;
+    }
+    memcpy(bundle->magic, DATA_BUNDLE_MAGIC, 4);
+    bundle->version = DATA_BUNDLE_VERSION;
+    bundle->tablesSize = (int)sizeof(GameTables);
+
+    // Stamp the sources before reading them, so a file changed in between
+    // leaves the bundle out of date rather than wrong
+    bool ok = true;
+    for (int f = 0; f < GAME_DATA_FILES && ok; f++) {
+        ok = dataFileStamp(gameDataPaths[f], &bundle->sources[f]);
+        if (!ok) fprintf(stderr, "Cannot open file: %s\n", gameDataPaths[f]);
+    }
+    GameData data;
+    if (!ok || !loadGameData(&data, GAME_DATA_ALL, NULL)) {
+        free(bundle);
+        return false;
+    }
+    bundle->tables = *data.tables;
+    freeGameData(&data);
+
+    char temporary[1024];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *file = fopen(temporary, "wb");
+    ok = file != NULL;
+    if (ok) {
+        ok = fwrite(bundle, sizeof(DataBundle), 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+        if (ok) {
+            remove(path);
+            ok = rename(temporary, path) == 0;
+        }
+    }
+    free(bundle);
+    if (!ok) fprintf(stderr, "Failed to write data bundle %s\n", path);
+    return ok;
+}
+
+// What a scenario document picks for both sides: the factions, unit counts and the loadout
+typedef struct {
+    int faction[2];                          // Registry faction of each side
+    long long int unitCounts[UNIT_REGISTRY_MAX_UNITS]; // By unit id
+    char hero[2][50];
+    char creature[2][50];
+    int researchLevel[2][RESEARCH_LINES];    // arastirma_seviyesi of each side, per research line
+} ScenarioSetup;
+
+// Read the factions, unit counts, heroes, creatures and research levels of a
+// scenario. The two sides are the first two factions of the registry the
+// document has an army for. Unit keys the side's faction does not have are
+// ignored. Returns false if the document is not JSON or has fewer than two armies.
+bool parseScenarioSetup(const UnitRegistry *registry, const char *scenarioJson, ScenarioSetup *setup) {
+    memset(setup, 0, sizeof(*setup));
+    JsonIndex senaryo;
+    if (!jsonIndexBuild(&senaryo, scenarioJson, strlen(scenarioJson))) {
+        return false;
+    }
+    int sides[2] = { -1, -1 };
+    int sideCount = 0;
+    for (int f = 0; f < registry->factionCount && sideCount < 2; f++) {
+        int army = jsonFind(&senaryo, 0, registry->factions[f].key);
+        if (army < 0 || senaryo.tokens[army].type != JSON_OBJECT) continue;
+        setup->faction[sideCount] = f;
+        sides[sideCount++] = army;
+    }
+    for (int side = 0; side < sideCount; side++) {
+        int birimler = jsonFind(&senaryo, sides[side], "birimler");
+        if (birimler >= 0 && senaryo.tokens[birimler].type == JSON_OBJECT) {
+            for (int member = jsonNextMember(&senaryo, birimler, -1); member >= 0; member = jsonNextMember(&senaryo, birimler, member)) {
+                char key[50] = "";
+                jsonString(&senaryo, member, key, sizeof(key));
+                int unit = unitRegistryUnit(registry, setup->faction[side], key);
+                if (unit >= 0) setup->unitCounts[unit] = jsonLongLong(&senaryo, member + 1, 0);
+            }
+        }
+        jsonString(&senaryo, jsonFind(&senaryo, sides[side], "kahraman"), setup->hero[side], sizeof(setup->hero[side]));
+        jsonString(&senaryo, jsonFind(&senaryo, sides[side], "canavar"), setup->creature[side], sizeof(setup->creature[side]));
+        // Each side's own research level, not the first match anywhere in the document
+        int levels = jsonFind(&senaryo, sides[side], "arastirma_seviyesi");
+        for (int line = 0; line < RESEARCH_LINES; line++) {
+            setup->researchLevel[side][line] = jsonInt(&senaryo, jsonFind(&senaryo, levels, researchKeys[line]), 0);
+        }
+    }
+    jsonIndexFree(&senaryo);
+    return sideCount == 2;
+}
+
+// Data files a scenario needs: unit types always, the others only if one of
+// its armies names a hero, a creature or a research level. Works before the
+// registry is loaded, so it looks at every object of the document's root.
+unsigned int scenarioDataNeeds(const char *scenarioJson) {
+    unsigned int needs = GAME_DATA_UNIT_TYPES;
+    JsonIndex senaryo;
+    if (!jsonIndexBuild(&senaryo, scenarioJson, strlen(scenarioJson))) {
+        return needs;
+    }
+    for (int member = jsonNextMember(&senaryo, 0, -1); member >= 0; member = jsonNextMember(&senaryo, 0, member)) {
+        int army = member + 1;
+        if (senaryo.tokens[army].type != JSON_OBJECT) continue;
+        char name[2] = "";
+        jsonString(&senaryo, jsonFind(&senaryo, army, "kahraman"), name, sizeof(name));
+        if (name[0] != '\0') needs |= GAME_DATA_HEROES;
+        name[0] = '\0';
+        jsonString(&senaryo, jsonFind(&senaryo, army, "canavar"), name, sizeof(name));
+        if (name[0] != '\0') needs |= GAME_DATA_CREATURES;
+        int levels = jsonFind(&senaryo, army, "arastirma_seviyesi");
+        for (int line = 0; line < RESEARCH_LINES; line++) {
+            if (jsonInt(&senaryo, jsonFind(&senaryo, levels, researchKeys[line]), 0) > 0) needs |= GAME_DATA_RESEARCH;
+        }
+    }
+    jsonIndexFree(&senaryo);
+    return needs;
+}
+
+// Apply the heroes, creatures and research of 'setup' to 'stats'
+void applyLoadout(const GameData *data, const ScenarioSetup *setup, ArmyStats *stats) {
+    const GameTables *tables = data->tables;
+    // Apply hero effects, then creature effects
+    for (int side = 0; side < 2; side++) {
+        applyEffectRules(findLoadoutEffect(&tables->heroes[setup->faction[side]], setup->hero[side]), stats);
+    }
+    for (int side = 0; side < 2; side++) {
+        applyEffectRules(findLoadoutEffect(&tables->creatures[setup->faction[side]], setup->creature[side]), stats);
+    }
+
+    // Apply research effects
+    for (int side = 0; side < 2; side++) {
+        int f = setup->faction[side];
+        applyResearch(&tables->research[f], setup->researchLevel[side], &tables->registry.factions[f], stats);
+    }
+}
+
+// Initialize unit health and counts of one side, one Birim per unit type of its faction
+void buildArmy(const UnitRegistry *registry, const ArmyStats *stats, const ScenarioSetup *setup, int side, Birim *birimler) {
+    const Faction *faction = &registry->factions[setup->faction[side]];
+    for (int i = 0; i < faction->unitCount; i++) {
+        int u = faction->firstUnit + i;
+        const UnitType *unit = &registry->units[u];
+        Birim *birim = &birimler[i];
+        memset(birim, 0, sizeof(*birim));
+        snprintf(birim->isim, sizeof(birim->isim), "%s", unit->isim);
+        birim->saldiri = stats->saldiri[u];
+        birim->savunma = stats->savunma[u];
+        birim->saglik = stats->saglik[u];
+        birim->maksimumSaglik = stats->saglik[u];
+        birim->kritikSans = stats->kritikSans[u];
+        birim->kalanBirimSayisi = setup->unitCounts[u];
+        birim->color = (Color){ unit->renk[0], unit->renk[1], unit->renk[2], unit->renk[3] };
+    }
+}
+
+// Set up a battle between the two armies of 'setup' with the given stats,
+// labelled with their factions' names
+bool setupBattle(BattleContext *ctx, const GameData *data, const ScenarioSetup *setup, const ArmyStats *stats,
+                 const BattleOptions *options, FILE *logFile) {
+    const UnitRegistry *registry = &data->tables->registry;
+    const Faction *factions[2] = { &registry->factions[setup->faction[0]], &registry->factions[setup->faction[1]] };
+    Birim *armies[2];
+    for (int side = 0; side < 2; side++) {
+        armies[side] = (Birim *)calloc(factions[side]->unitCount + 1, sizeof(Birim));
+    }
+    bool ok = armies[0] != NULL && armies[1] != NULL;
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed!\n");
+    } else {
+        buildArmy(registry, stats, setup, 0, armies[0]);
+        buildArmy(registry, stats, setup, 1, armies[1]);
+        ok = battleInit(ctx, armies[0], factions[0]->unitCount, armies[1], factions[1]->unitCount, options, logFile);
+    }
+    for (int side = 0; side < 2 && ok; side++) {
+        battleSetLabels(ctx, side, factions[side]->etiket, factions[side]->cogulEtiket);
+    }
+    free(armies[0]);
+    free(armies[1]);
+    return ok;
+}
+
+// Winner of 'outcome' as the plural name of its faction, or "Draw" / "Ongoing"
+const char *scenarioOutcomeName(const GameData *data, const ScenarioSetup *setup, BattleOutcome outcome) {
+    if (outcome != BATTLE_HUMANS_WIN && outcome != BATTLE_ORCS_WIN) return battleOutcomeName(outcome);
+    return data->tables->registry.factions[setup->faction[outcome == BATTLE_HUMANS_WIN ? SIDE_HUMAN : SIDE_ORC]].cogulEtiket;
+}
+
+// Batch runner
+// Plays many scenario documents on a WorkerPool, a group of them per task:
+// the group's battles are set up one by one and then played together by
+// battleRunManyCached, so they share the batch engine's lanes. Input is a
+// directory of *.json files or a JSONL stream (one document per line, "-"
+// for stdin), read in chunks so a stream of any length fits in memory. Every
+// battle gets its own BattleContext with no log and no pool; the unit data is
+// read once and shared read-only. One JSON line per scenario is written as
+// soon as its group ends, so lines come in completion order and carry the
+// input index.
+
+// Documents handed to the pool per parallelFor call
+#define BATCH_RUN_CHUNK 256
+
+typedef struct {
+    const GameData *data;
+    const BattleOptions *options;
+    char **labels;           // Scenario names of this chunk
+    char **documents;        // Scenario JSON per label, NULL = read the file named by the label
+    const char *directory;   // Directory of the files (directory input only)
+    int firstIndex;          // Input index of labels[0]
+    int count;               // Scenarios in labels
+    int groupSize;           // Scenarios per task
+    FILE *output;
+    CRITICAL_SECTION outputLock;
+    ResultCache *cache;
+    volatile LONG failed;
+} BatchRunJob;
+
+// Append 'text' to 'dest' as a JSON string body (quotes and controls escaped)
+static void batchJsonEscape(char *dest, size_t destSize, const char *text) {
+    size_t n = 0;
+    for (; *text != '\0' && n + 7 < destSize; text++) {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\') {
+            dest[n++] = '\\';
+            dest[n++] = (char)c;
+        } else if (c < 0x20) {
+            n += snprintf(dest + n, destSize - n, "\\u%04x", c);
+        } else {
+            dest[n++] = (char)c;
+        }
+    }
+    dest[n] = '\0';
+}
+
+// 'directory' + separator + 'name'; the separator follows the one the directory uses
+static void batchJoinPath(char *dest, size_t destSize, const char *directory, const char *name) {
+    size_t length = strlen(directory);
+    bool hasSeparator = length > 0 && (directory[length - 1] == '\\' || directory[length - 1] == '/');
+    const char *separator = hasSeparator ? "" : (strchr(directory, '/') != NULL ? "/" : "\\");
+    snprintf(dest, destSize, "%s%s%s", directory, separator, name);
+}
+
+// Write one finished line; lines from different threads never interleave
+static void batchWriteResult(BatchRunJob *job, const char *line) {
+    EnterCriticalSection(&job->outputLock);
+    fputs(line, job->output);
+    fflush(job->output);
+    LeaveCriticalSection(&job->outputLock);
+}
+
+// One scenario of a batch task
+typedef struct {
+    ScenarioSetup setup;
+    unsigned long long int seed;
+    const char *error;       // NULL once its battle is set up
+    double seconds;          // Reading and setting it up
+} BatchScenario;
+
+// Read and set up scenario 'task' of the chunk into 'battle'
+static void batchSetupScenario(BatchRunJob *job, int task, BatchScenario *scenario, BattleContext *battle) {
+    double start = wallClockSeconds();
+    char *document = job->documents != NULL ? job->documents[task] : NULL;
+    char *ownedDocument = NULL;
+    if (document == NULL) {
+        char path[1024];
+        batchJoinPath(path, sizeof(path), job->directory, job->labels[task]);
+        ownedDocument = readJsonFromFile(path);
+        document = ownedDocument;
+    }
+    scenario->error = NULL;
+    if (document == NULL) {
+        scenario->error = "cannot read file";
+    }
+
+    // Random crits get a seed per input index, whatever thread runs the task
+    BattleOptions options = *job->options;
+    options.seed = battleDeriveSeed(job->options->seed, job->firstIndex + task);
+    scenario->seed = options.seed;
+    if (scenario->error == NULL) {
+        ArmyStats stats = job->data->tables->baseStats;
+        if (!parseScenarioSetup(&job->data->tables->registry, document, &scenario->setup)) {
+            scenario->error = "not a scenario document";
+        } else {
+            applyLoadout(job->data, &scenario->setup, &stats);
+            if (!setupBattle(battle, job->data, &scenario->setup, &stats, &options, NULL)) {
+                scenario->error = "out of memory";
+            }
+        }
+    }
+    free(ownedDocument);
+    if (scenario->error == NULL) {
+        battle->cache = job->cache;
+    }
+    scenario->seconds = wallClockSeconds() - start;
+}
+
+// Write the line of scenario 'task' of the chunk: its error, or its result
+// with 'battle' played ('battle' is NULL with an error)
+static void batchReportScenario(BatchRunJob *job, int task, const BatchScenario *scenario, const BattleContext *battle,
+                                double wallTime) {
+    char label[512];
+    char line[16384];
+    batchJsonEscape(label, sizeof(label), job->labels[task]);
+    int length = snprintf(line, sizeof(line), "{\"index\":%d,\"scenario\":\"%s\",", job->firstIndex + task, label);
+    if (battle == NULL) {
+        InterlockedIncrement(&job->failed);
+        snprintf(line + length, sizeof(line) - length, "\"error\":\"%s\"}\n", scenario != NULL ? scenario->error : "out of memory");
+        batchWriteResult(job, line);
+        return;
+    }
+
+    length += snprintf(line + length, sizeof(line) - length, "\"winner\":\"%s\",\"rounds\":%d,",
+                       battleWinnerName(battle), battle->roundsPlayed);
+    if (battle->stoppedEarly) {
+        length += snprintf(line + length, sizeof(line) - length, "\"stopped_early\":true,");
+    }
+    if (job->options->randomCrits) {
+        length += snprintf(line + length, sizeof(line) - length, "\"seed\":%llu,", scenario->seed);
+    }
+    if (battle->fromCache) {
+        length += snprintf(line + length, sizeof(line) - length, "\"cached\":true,");
+    }
+    // Survivors under the data file keys; the line is long enough for a full registry
+    const UnitRegistry *registry = &job->data->tables->registry;
+    length += snprintf(line + length, sizeof(line) - length, "\"survivors\":{");
+    for (int s = 0; s < 2; s++) {
+        const Faction *faction = &registry->factions[scenario->setup.faction[s]];
+        length += snprintf(line + length, sizeof(line) - length, "%s\"%s\":{", s > 0 ? "," : "", faction->key);
+        for (int i = 0; i < battle->sides[s].birimSayisi; i++) {
+            length += snprintf(line + length, sizeof(line) - length, "%s\"%s\":%lld", i > 0 ? "," : "",
+                               registry->units[faction->firstUnit + i].key, battle->sides[s].kalanBirimSayisi[i]);
+        }
+        length += snprintf(line + length, sizeof(line) - length, "}");
+    }
+    snprintf(line + length, sizeof(line) - length, "},\"wall_time_ms\":%.3f}\n", wallTime * 1000.0);
+    batchWriteResult(job, line);
+}
+
+// Set up one group of scenarios, play their battles together and report
+// them. A scenario's wall time is its own setup plus an equal share of the
+// time the group's battles took.
+static void batchRunTask(void *arg, int group) {
+    BatchRunJob *job = (BatchRunJob *)arg;
+    int first = group * job->groupSize;
+    int count = job->count - first < job->groupSize ? job->count - first : job->groupSize;
+    BatchScenario *scenarios = (BatchScenario *)calloc(count, sizeof(BatchScenario));
+    BattleContext *battles = (BattleContext *)calloc(count, sizeof(BattleContext));
+    if (scenarios == NULL || battles == NULL) {
+        for (int i = 0; i < count; i++) batchReportScenario(job, first + i, NULL, NULL, 0.0);
+        free(scenarios);
+        free(battles);
+        return;
+    }
+
+    // Battles that could be set up are packed at the front of 'battles'
+    int played = 0;
+    for (int i = 0; i < count; i++) {
+        batchSetupScenario(job, first + i, &scenarios[i], &battles[played]);
+        if (scenarios[i].error == NULL) played++;
+    }
+    double start = wallClockSeconds();
+    battleRunManyCached(battles, played);
+    double share = played > 0 ? (wallClockSeconds() - start) / played : 0.0;
+
+    int b = 0;
+    for (int i = 0; i < count; i++) {
+        if (scenarios[i].error != NULL) {
+            batchReportScenario(job, first + i, &scenarios[i], NULL, 0.0);
+            continue;
+        }
+        batchReportScenario(job, first + i, &scenarios[i], &battles[b], scenarios[i].seconds + share);
+        battleDestroy(&battles[b++]);
+    }
+    free(scenarios);
+    free(battles);
+}
+
+// Play the 'count' scenarios of the current chunk of 'job' in groups on 'pool'
+static void batchRunChunk(WorkerPool *pool, BatchRunJob *job, int count) {
+    job->count = count;
+    job->groupSize = battleGroupSize(pool, count);
+    parallelFor(pool, battleGroupCount(count, job->groupSize), batchRunTask, job);
+}
+
+// Read one line of any length into '*buffer'; false at end of input
+static bool batchReadLine(FILE *input, char **buffer, size_t *capacity) {
+    size_t length = 0;
+    while (true) {
+        if (*capacity - length < 2) {
+            size_t newCapacity = *capacity > 0 ? *capacity * 2 : 4096;
+            char *grown = (char *)realloc(*buffer, newCapacity);
+            if (grown == NULL) return false;
+            *buffer = grown;
+            *capacity = newCapacity;
+        }
+        if (fgets(*buffer + length, (int)(*capacity - length), input) == NULL) {
+            (*buffer)[length] = '\0';
+            return length > 0;
+        }
+        length += strlen(*buffer + length);
+        if (length > 0 && (*buffer)[length - 1] == '\n') {
+            return true;
+        }
+    }
+}
+
+static int batchCompareNames(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Names of the *.json files in 'directory', sorted; returns the count or -1
+static int batchListDirectory(const char *directory, char ***names) {
+    char pattern[1024];
+    batchJoinPath(pattern, sizeof(pattern), directory, "*.json");
+    *names = NULL;
+    int count = 0, capacity = 0;
+    WIN32_FIND_DATAA findData;
+    HANDLE find = FindFirstFileA(pattern, &findData);
+    if (find == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    do {
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            char **grown = (char **)realloc(*names, capacity * sizeof(char *));
+            if (grown == NULL) break;
+            *names = grown;
+        }
+        (*names)[count] = strdup(findData.cFileName);
+        if ((*names)[count] == NULL) break;
+        count++;
+    } while (FindNextFileA(find, &findData));
+    FindClose(find);
+    qsort(*names, count, sizeof(char *), batchCompareNames);
+    return count;
+}
+
+// Run every scenario of 'inputPath' (directory, JSONL file or "-") and write
+// the results to 'outputPath' (NULL = stdout). Returns the process exit code.
+int runBatch(const char *inputPath, const char *outputPath, const BattleOptions *options, int threadCount, ResultCache *cache,
+             const char *bundlePath) {
+    BatchRunJob job;
+    memset(&job, 0, sizeof(job));
+    GameData gameData;
+    if (!loadGameData(&gameData, GAME_DATA_ALL, bundlePath)) {
+        return EXIT_FAILURE;
+    }
+    job.data = &gameData;
+    job.options = options;
+    job.cache = cache;
+    job.output = stdout;
+    if (outputPath != NULL && (job.output = fopen(outputPath, "w")) == NULL) {
+        fprintf(stderr, "Failed to open batch output: %s\n", outputPath);
+        freeGameData(&gameData);
+        return EXIT_FAILURE;
+    }
+    InitializeCriticalSection(&job.outputLock);
+    WorkerPool pool;
+    workerPoolInit(&pool, threadCount);
+
+    double start = wallClockSeconds();
+    int total = 0;
+    bool inputOk = true;
+    bool isDirectory = strcmp(inputPath, "-") != 0 && GetFileAttributesA(inputPath) != INVALID_FILE_ATTRIBUTES &&
+                       (GetFileAttributesA(inputPath) & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    if (isDirectory) {
+        // Files are read inside the tasks, so reading overlaps with battles
+        char **names;
+        total = batchListDirectory(inputPath, &names);
+        job.directory = inputPath;
+        for (int first = 0; first < total; first += BATCH_RUN_CHUNK) {
+            job.labels = names + first;
+            job.firstIndex = first;
+            batchRunChunk(&pool, &job, total - first < BATCH_RUN_CHUNK ? total - first : BATCH_RUN_CHUNK);
+        }
+        for (int i = 0; i < total; i++) free(names[i]);
+        free(names);
+    } else {
+        FILE *input = strcmp(inputPath, "-") == 0 ? stdin : fopen(inputPath, "r");
+        if (input == NULL) {
+            fprintf(stderr, "Cannot open batch input: %s\n", inputPath);
+            inputOk = false;
+        } else {
+            char *labels[BATCH_RUN_CHUNK];
+            char *documents[BATCH_RUN_CHUNK];
+            char *line = NULL;
+            size_t capacity = 0;
+            int lineNumber = 0;
+            bool more = true;
+            job.labels = labels;
+            job.documents = documents;
+            while (more) {
+                int count = 0;
+                job.firstIndex = total;
+                while (count < BATCH_RUN_CHUNK && (more = batchReadLine(input, &line, &capacity))) {
+                    lineNumber++;
+                    if (strspn(line, " \t\r\n") == strlen(line)) continue; // Blank line
+                    char label[64];
+                    snprintf(label, sizeof(label), "line %d", lineNumber);
+                    labels[count] = strdup(label);
+                    documents[count] = strdup(line);
+                    count++;
+                }
+                batchRunChunk(&pool, &job, count);
+                for (int i = 0; i < count; i++) {
+                    free(labels[i]);
+                    free(documents[i]);
+                }
+                total += count;
+            }
+            free(line);
+            if (input != stdin) fclose(input);
+        }
+    }
+    double seconds = wallClockSeconds() - start;
+
+    if (inputOk) {
+        fprintf(stderr, "Batch: %d scenarios, %ld failed, %d threads, %.3f s\n",
+                total, (long)job.failed, pool.threadCount + 1, seconds);
+    }
+    workerPoolDestroy(&pool);
+    DeleteCriticalSection(&job.outputLock);
+    if (job.output != stdout) fclose(job.output);
+    freeGameData(&gameData);
+    return inputOk && job.failed == 0 ? 0 : EXIT_FAILURE;
+}
+
+// Loadout optimizer
+// Tries every hero x creature x research level of one side (each may also be
+// left out) against the scenario's opponent. The base unit stats are compiled
+// once in GameData and every candidate only applies its own effects. Two kinds
+// of candidates are not simulated: those whose stats equal an earlier one's
+// (they share its result) and those another candidate dominates, i.e. it has
+// at least the same saldiri, savunma and kritik_sans on every unit and more
+// on one. The rest run one battle each on the worker pool.
+
+#define LOADOUT_MAX_CHOICES 32
+
+typedef struct {
+    char hero[50];
+    char creature[50];
+    int researchLevel[RESEARCH_LINES];
+    ArmyStats stats;
+    int sameAs;              // Earlier candidate with identical stats (-1 = none)
+    int dominatedBy;         // Candidate with better or equal stats everywhere (-1 = none)
+    BattleOutcome outcome;
+    int rounds;
+    long long int ownLeft;   // Surviving units of the optimized side
+    long long int enemyLeft;
+} LoadoutCandidate;
+
+typedef struct {
+    const GameData *data;
+    const ScenarioSetup *setup;
+    const BattleOptions *options;
+    LoadoutCandidate *candidates;
+    int *simulated;          // Candidate index per simulated loadout
+    int simulatedCount;
+    int groupSize;           // Loadouts per task, played together
+    int side;
+    ResultCache *cache;
+    volatile LONG failed;
+} LoadoutJob;
+
+static void loadoutTask(void *arg, int group) {
+    LoadoutJob *job = (LoadoutJob *)arg;
+    int first = group * job->groupSize;
+    int count = job->simulatedCount - first < job->groupSize ? job->simulatedCount - first : job->groupSize;
+    BattleContext *battles = (BattleContext *)calloc(count, sizeof(BattleContext));
+    int ready = 0;
+    while (battles != NULL && ready < count &&
+           setupBattle(&battles[ready], job->data, job->setup, &job->candidates[job->simulated[first + ready]].stats,
+                       job->options, NULL)) {
+        battles[ready++].cache = job->cache;
+    }
+    if (ready < count) {
+        InterlockedIncrement(&job->failed);
+    } else {
+        battleRunManyCached(battles, count);
+        for (int i = 0; i < count; i++) {
+            LoadoutCandidate *candidate = &job->candidates[job->simulated[first + i]];
+            candidate->outcome = battles[i].outcome;
+            candidate->rounds = battles[i].roundsPlayed;
+            candidate->ownLeft = battleTotalUnits(&battles[i].sides[job->side]);
+            candidate->enemyLeft = battleTotalUnits(&battles[i].sides[1 - job->side]);
+        }
+    }
+    for (int i = 0; i < ready; i++) battleDestroy(&battles[i]);
+    free(battles);
+}
+
+// True if, in every effect-driven stat, the units of 'own' are at least as
+// strong in 'a' as in 'b' and those of 'enemy' at most as strong, and one
+// stat differs. Effects can target units of another faction, so both count.
+static bool loadoutDominates(const ArmyStats *a, const ArmyStats *b, const Faction *own, const Faction *enemy) {
+    bool better = false;
+    for (int f = 0; f < 2; f++) {
+        const Faction *faction = f == 0 ? own : enemy;
+        // For the enemy, 'a' is better where its stats are lower
+        const ArmyStats *high = f == 0 ? a : b;
+        const ArmyStats *low = f == 0 ? b : a;
+        for (int u = faction->firstUnit; u < faction->firstUnit + faction->unitCount; u++) {
+            if (high->saldiri[u] < low->saldiri[u] || high->savunma[u] < low->savunma[u] || high->kritikSans[u] < low->kritikSans[u]) {
+                return false;
+            }
+            if (high->saldiri[u] > low->saldiri[u] || high->savunma[u] > low->savunma[u] || high->kritikSans[u] > low->kritikSans[u]) {
+                better = true;
+            }
+        }
+    }
+    return better;
+}
+
+// Rank value of an outcome for the optimized side
+static int loadoutOutcomeRank(BattleOutcome outcome, int side) {
+    if (outcome == BATTLE_DRAW) return 1;
+    return (outcome == BATTLE_HUMANS_WIN) == (side == SIDE_HUMAN) ? 2 : 0;
+}
+
+static int loadoutSide; // Side being ranked, for qsort
+static const LoadoutCandidate *loadoutRanked;
+
+// Better result first: outcome, own survivors, enemy survivors, then a fast
+// win or a long defeat; ties keep enumeration order
+static int loadoutCompare(const void *x, const void *y) {
+    const LoadoutCandidate *a = &loadoutRanked[*(const int *)x];
+    const LoadoutCandidate *b = &loadoutRanked[*(const int *)y];
+    int rankA = loadoutOutcomeRank(a->outcome, loadoutSide), rankB = loadoutOutcomeRank(b->outcome, loadoutSide);
+    if (rankA != rankB) return rankB - rankA;
+    if (a->ownLeft != b->ownLeft) return a->ownLeft > b->ownLeft ? -1 : 1;
+    if (a->enemyLeft != b->enemyLeft) return a->enemyLeft < b->enemyLeft ? -1 : 1;
+    if (a->rounds != b->rounds) return (rankA == 2) == (a->rounds < b->rounds) ? -1 : 1;
+    return *(const int *)x - *(const int *)y;
+}
+
+// Short label of one candidate
+static void loadoutLabel(const LoadoutCandidate *candidate, char *dest, size_t destSize) {
+    snprintf(dest, destSize, "%s / %s / %d/%d", candidate->hero[0] != '\0' ? candidate->hero : "-",
+             candidate->creature[0] != '\0' ? candidate->creature : "-",
+             candidate->researchLevel[RESEARCH_SAVUNMA], candidate->researchLevel[RESEARCH_SALDIRI]);
+}
+
+// Rank every loadout of side 'side' against the scenario's other side
+void runLoadoutOptimizer(const GameData *data, const char *scenarioJson, int side, const BattleOptions *options, WorkerPool *pool,
+                         ResultCache *cache) {
+    const GameTables *tables = data->tables;
+    ScenarioSetup setup;
+    if (!parseScenarioSetup(&tables->registry, scenarioJson, &setup)) return;
+    int faction = setup.faction[side];
+    const Faction *factions[2] = { &tables->registry.factions[setup.faction[0]], &tables->registry.factions[setup.faction[1]] };
+
+    // Choices from the data files; index 0 is "none"
+    char heroes[LOADOUT_MAX_CHOICES + 1][50] = { "" };
+    char creatures[LOADOUT_MAX_CHOICES + 1][50] = { "" };
+    int heroCount = 1, creatureCount = 1;
+    const int *maxLevel = tables->research[faction].maxLevel;
+    for (int e = 0; e < tables->heroes[faction].count && heroCount <= LOADOUT_MAX_CHOICES; e++) {
+        snprintf(heroes[heroCount++], sizeof(heroes[0]), "%s", tables->heroes[faction].effects[e].isim);
+    }
+    for (int e = 0; e < tables->creatures[faction].count && creatureCount <= LOADOUT_MAX_CHOICES; e++) {
+        snprintf(creatures[creatureCount++], sizeof(creatures[0]), "%s", tables->creatures[faction].effects[e].isim);
+    }
+
+    int levelCount = (maxLevel[RESEARCH_SAVUNMA] + 1) * (maxLevel[RESEARCH_SALDIRI] + 1);
+    int count = heroCount * creatureCount * levelCount;
+    LoadoutCandidate *candidates = (LoadoutCandidate *)calloc(count, sizeof(LoadoutCandidate));
+    int *order = (int *)malloc(count * sizeof(int));
+    if (candidates == NULL || order == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(candidates);
+        free(order);
+        return;
+    }
+
+    // Compile every candidate from the shared base stats
+    int c = 0;
+    for (int h = 0; h < heroCount; h++) {
+        for (int k = 0; k < creatureCount; k++) {
+            for (int levels = 0; levels < levelCount; levels++, c++) {
+                LoadoutCandidate *candidate = &candidates[c];
+                ScenarioSetup loadout = setup;
+                snprintf(loadout.hero[side], sizeof(loadout.hero[side]), "%.49s", heroes[h]);
+                snprintf(loadout.creature[side], sizeof(loadout.creature[side]), "%.49s", creatures[k]);
+                loadout.researchLevel[side][RESEARCH_SAVUNMA] = levels / (maxLevel[RESEARCH_SALDIRI] + 1);
+                loadout.researchLevel[side][RESEARCH_SALDIRI] = levels % (maxLevel[RESEARCH_SALDIRI] + 1);
+                snprintf(candidate->hero, sizeof(candidate->hero), "%.49s", heroes[h]);
+                snprintf(candidate->creature, sizeof(candidate->creature), "%.49s", creatures[k]);
+                memcpy(candidate->researchLevel, loadout.researchLevel[side], sizeof(candidate->researchLevel));
+                candidate->stats = data->tables->baseStats;
+                applyLoadout(data, &loadout, &candidate->stats);
+                candidate->sameAs = -1;
+                candidate->dominatedBy = -1;
+            }
+        }
+    }
+
+    // Prune duplicates and dominated candidates
+    int simulatedCount = 0, sameCount = 0, dominatedCount = 0;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < i && candidates[i].sameAs < 0; j++) {
+            if (candidates[j].sameAs < 0 && memcmp(&candidates[i].stats, &candidates[j].stats, sizeof(ArmyStats)) == 0) {
+                candidates[i].sameAs = j;
+                sameCount++;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (candidates[i].sameAs >= 0) continue;
+        for (int j = 0; j < count && candidates[i].dominatedBy < 0; j++) {
+            if (candidates[j].sameAs < 0 && loadoutDominates(&candidates[j].stats, &candidates[i].stats, factions[side], factions[1 - side])) {
+                candidates[i].dominatedBy = j;
+            }
+        }
+        if (candidates[i].dominatedBy >= 0) {
+            dominatedCount++;
+        } else {
+            order[simulatedCount++] = i;
+        }
+    }
 
-                // Loglama
-                fprintf(logFile, "Human unit (%s) attacks Orc unit (%s) for %lld damage.\n", insanImparatorlugu[i].isim, orkLegionu[targetIndex].isim, damage);
+    BattleOptions battleOptions = *options;
+    int groupSize = battleGroupSize(pool, simulatedCount);
+    LoadoutJob job = { data, &setup, &battleOptions, candidates, order, simulatedCount, groupSize, side, cache, 0 };
+    double start = wallClockSeconds();
+    parallelFor(pool, battleGroupCount(simulatedCount, groupSize), loadoutTask, &job);
+    double seconds = wallClockSeconds() - start;
+    if (job.failed > 0) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(candidates);
+        free(order);
+        return;
+    }
 
-                // Orc biriminin lmesi durumunda
-                if (orkLegionu[targetIndex].saglik <= 0) {
-                    orkLegionu[targetIndex].saglik = orkLegionu[targetIndex].maksimumSaglik;
-                    orkLegionu[targetIndex].kalanBirimSayisi--;
-                    fprintf(logFile, "Orc unit (%s) has been defeated. Remaining units: %lld\n", orkLegionu[targetIndex].isim, orkLegionu[targetIndex].kalanBirimSayisi);
-                }
-            }
+    // Identical loadouts share the result; rank everything that has one
+    int rankedCount = 0;
+    for (int i = 0; i < count; i++) {
+        int source = candidates[i].sameAs >= 0 ? candidates[i].sameAs : i;
+        if (candidates[source].dominatedBy >= 0) continue;
+        if (source != i) {
+            candidates[i].outcome = candidates[source].outcome;
+            candidates[i].rounds = candidates[source].rounds;
+            candidates[i].ownLeft = candidates[source].ownLeft;
+            candidates[i].enemyLeft = candidates[source].enemyLeft;
         }
+        order[rankedCount++] = i;
     }
+    loadoutSide = side;
+    loadoutRanked = candidates;
+    qsort(order, rankedCount, sizeof(int), loadoutCompare);
+
+    printf("Loadout optimizer: %s vs the scenario's %s, %d loadouts, %d simulated, %d identical, %d dominated\n",
+           factions[side]->cogulEtiket, factions[1 - side]->cogulEtiket,
+           count, simulatedCount, sameCount, dominatedCount);
+    printf("%d threads, %.3f s\n", pool != NULL ? pool->threadCount + 1 : 1, seconds);
+    printf("Rank  %-22s %-18s Res. d/a  Winner  Rounds  Own left  Enemy left\n", "Hero", "Creature");
+    for (int r = 0; r < rankedCount; r++) {
+        const LoadoutCandidate *candidate = &candidates[order[r]];
+        char research[24];
+        snprintf(research, sizeof(research), "%d/%d", candidate->researchLevel[RESEARCH_SAVUNMA], candidate->researchLevel[RESEARCH_SALDIRI]);
+        printf("%4d  %-22s %-18s %8s  %-6s  %6d  %8lld  %10lld\n", r + 1,
+               candidate->hero[0] != '\0' ? candidate->hero : "-",
+               candidate->creature[0] != '\0' ? candidate->creature : "-",
+               research, scenarioOutcomeName(data, &setup, candidate->outcome),
+               candidate->rounds, candidate->ownLeft, candidate->enemyLeft);
+    }
+    if (dominatedCount > 0) {
+        printf("Dominated (not simulated):\n");
+        for (int i = 0; i < count; i++) {
+            int source = candidates[i].sameAs >= 0 ? candidates[i].sameAs : i;
+            if (candidates[source].dominatedBy < 0) continue;
+            char label[128], betterLabel[128];
+            loadoutLabel(&candidates[i], label, sizeof(label));
+            loadoutLabel(&candidates[candidates[source].dominatedBy], betterLabel, sizeof(betterLabel));
+            printf(" - %s, beaten by %s\n", label, betterLabel);
+        }
+    }
+    free(candidates);
+    free(order);
+}
 
-    // ORC ATTACK
-    for (int i = 0; i < orkUnitCount; i++) {
-        if (orkLegionu[i].kalanBirimSayisi > 0) {
-            // Increment attack count
-            attackCountOrc[i]++;
-            // Check for critical hit
-            bool isCritical = false;
-            if (attackCountOrc[i] >= critThresholdOrc[i]) {
-                isCritical = true;
-                attackCountOrc[i] = 0; // Reset counter after critical hit
-            }
-
-            // Calculate attack power
-            long long int attackPower = (long long int)orkLegionu[i].saldiri * orkLegionu[i].kalanBirimSayisi;
-            if (isCritical) {
-                attackPower = (long long int)(attackPower * 1.5); // Increase by 50%
-                fprintf(logFile, "Round %d: Orc unit (%s) lands a SCHEDULED CRITICAL HIT! Attack power increased by 50%% to %lld.\n", round, orkLegionu[i].isim, attackPower);
-            }
+// Sensitivity analysis
+// Moves one input by -delta and +delta at a time and replays the scenario:
+// saldiri, savunma, saglik and kritik_sans of every unit type of both
+// factions as read from unit_types.json (before heroes, creatures and
+// research), plus the fatigue rate and frequency. Integer inputs move by at
+// least 1. All runs start from the base stats compiled once in GameData and
+// run together on the worker pool. Inputs are ranked by how far the survivor
+// margin (first side left - second side left) moves between the two runs,
+// then by rounds.
 
-            // Hedef Human birimini se
-            int targetIndex = insanAttackIndex;
-            // Find the next available Human unit
-            bool targetFound = false;
-            for (int k = 0; k < insanUnitCount; k++) {
-                int currentIndex = (insanAttackIndex + k) % insanUnitCount;
-                if (insanImparatorlugu[currentIndex].kalanBirimSayisi > 0) {
-                    targetIndex = currentIndex;
-                    insanAttackIndex = (currentIndex + 1) % insanUnitCount;
-                    targetFound = true;
-                    break;
-                }
-            }
+#define SENSITIVITY_STATS 4
 
-            if (targetFound) {
-                // Hasar hesaplama
-                long long int damage = calculateNetDamage(attackPower, (long long int)insanImparatorlugu[targetIndex].savunma);
-                insanImparatorlugu[targetIndex].saglik -= damage;
+typedef struct {
+    BattleOutcome outcome;
+    int rounds;
+    long long int left[2];
+} SensitivityResult;
 
-                // Loglama
-                fprintf(logFile, "Orc unit (%s) attacks Human unit (%s) for %lld damage.\n", orkLegionu[i].isim, insanImparatorlugu[targetIndex].isim, damage);
+typedef struct {
+    const GameData *data;
+    const ScenarioSetup *setup;
+    const BattleOptions *options;
+    double delta;                // Relative change, e.g. 0.1
+    int unitCount;               // Unit types of both sides; parameters past unitCount * SENSITIVITY_STATS are fatigue
+    int units[2 * UNIT_REGISTRY_MAX_UNITS]; // Unit id per unit parameter group, first side then second
+    SensitivityResult *results;  // Run 0 is the baseline, then -/+ per parameter
+    double (*values)[2];         // Value of each parameter in the - and + run
+    int runCount;
+    int groupSize;               // Runs per task, played together
+    ResultCache *cache;
+    volatile LONG failed;
+} SensitivityJob;
+
+// Move an integer input by 'delta' (at least by 1), keeping it >= 'minimum'
+static int sensitivityShift(int value, double delta, int minimum) {
+    int shifted = (int)lround(value * (1.0 + delta));
+    if (shifted == value) shifted += delta < 0 ? -1 : 1;
+    return shifted < minimum ? minimum : shifted;
+}
 
-                // Human biriminin lmesi durumunda
-                if (insanImparatorlugu[targetIndex].saglik <= 0) {
-                    insanImparatorlugu[targetIndex].saglik = insanImparatorlugu[targetIndex].maksimumSaglik;
-                    insanImparatorlugu[targetIndex].kalanBirimSayisi--;
-                    fprintf(logFile, "Human unit (%s) has been defeated. Remaining units: %lld\n", insanImparatorlugu[targetIndex].isim, insanImparatorlugu[targetIndex].kalanBirimSayisi);
-                }
-            }
+// Set up run 'task' of the analysis
+static bool sensitivitySetup(SensitivityJob *job, int task, BattleContext *battle) {
+    ArmyStats stats = job->data->tables->baseStats;
+    BattleOptions options = *job->options;
+    if (task > 0) {
+        int parameter = (task - 1) / 2;
+        double delta = (task - 1) % 2 == 0 ? -job->delta : job->delta;
+        double value;
+        if (parameter < job->unitCount * SENSITIVITY_STATS) {
+            int u = job->units[parameter / SENSITIVITY_STATS];
+            int *fields[SENSITIVITY_STATS] = { &stats.saldiri[u], &stats.savunma[u], &stats.saglik[u], &stats.kritikSans[u] };
+            int *field = fields[parameter % SENSITIVITY_STATS];
+            *field = sensitivityShift(*field, delta, parameter % SENSITIVITY_STATS == 2 ? 1 : 0);
+            value = *field;
+        } else if (parameter == job->unitCount * SENSITIVITY_STATS) {
+            options.fatiguePercentage = (float)(options.fatiguePercentage * (1.0 + delta));
+            value = options.fatiguePercentage;
+        } else {
+            options.fatigueFrequency = sensitivityShift(options.fatigueFrequency, delta, 1);
+            value = options.fatigueFrequency;
         }
+        job->values[parameter][(task - 1) % 2] = value;
     }
-
-    // Mevcut durumu logla
-    fprintf(logFile, "Status after Round %d:\n", roundNumber);
-    fprintf(logFile, "Humans:\n");
-    for (int i = 0; i < insanUnitCount; i++) {
-        fprintf(logFile, " - %s: %lld units remaining, Health per unit: %d\n", insanImparatorlugu[i].isim, insanImparatorlugu[i].kalanBirimSayisi, insanImparatorlugu[i].saglik);
+    applyLoadout(job->data, job->setup, &stats);
+    if (!setupBattle(battle, job->data, job->setup, &stats, &options, NULL)) {
+        return false;
     }
+    battle->cache = job->cache;
+    return true;
+}
 
-    fprintf(logFile, "Orcs:\n");
-    for (int i = 0; i < orkUnitCount; i++) {
-        fprintf(logFile, " - %s: %lld units remaining, Health per unit: %d\n", orkLegionu[i].isim, orkLegionu[i].kalanBirimSayisi, orkLegionu[i].saglik);
+static void sensitivityTask(void *arg, int group) {
+    SensitivityJob *job = (SensitivityJob *)arg;
+    int first = group * job->groupSize;
+    int count = job->runCount - first < job->groupSize ? job->runCount - first : job->groupSize;
+    BattleContext *battles = (BattleContext *)calloc(count, sizeof(BattleContext));
+    int ready = 0;
+    while (battles != NULL && ready < count && sensitivitySetup(job, first + ready, &battles[ready])) {
+        ready++;
     }
+    if (ready < count) {
+        InterlockedIncrement(&job->failed);
+    } else {
+        battleRunManyCached(battles, count);
+        for (int i = 0; i < count; i++) {
+            SensitivityResult *result = &job->results[first + i];
+            result->outcome = battles[i].outcome;
+            result->rounds = battles[i].roundsPlayed;
+            result->left[SIDE_HUMAN] = battleTotalUnits(&battles[i].sides[SIDE_HUMAN]);
+            result->left[SIDE_ORC] = battleTotalUnits(&battles[i].sides[SIDE_ORC]);
+        }
+    }
+    for (int i = 0; i < ready; i++) battleDestroy(&battles[i]);
+    free(battles);
+}
 
-    fprintf(logFile, "----------------------------------------\n");
+static const SensitivityJob *sensitivityRanked; // For qsort
+
+static long long int sensitivityMarginChange(const SensitivityJob *job, int parameter) {
+    const SensitivityResult *low = &job->results[1 + 2 * parameter], *high = &job->results[2 + 2 * parameter];
+    long long int change = (high->left[SIDE_HUMAN] - high->left[SIDE_ORC]) - (low->left[SIDE_HUMAN] - low->left[SIDE_ORC]);
+    return change < 0 ? -change : change;
+}
+
+static int sensitivityCompare(const void *x, const void *y) {
+    int a = *(const int *)x, b = *(const int *)y;
+    long long int marginA = sensitivityMarginChange(sensitivityRanked, a), marginB = sensitivityMarginChange(sensitivityRanked, b);
+    if (marginA != marginB) return marginA > marginB ? -1 : 1;
+    const SensitivityResult *r = sensitivityRanked->results;
+    int roundsA = abs(r[2 + 2 * a].rounds - r[1 + 2 * a].rounds), roundsB = abs(r[2 + 2 * b].rounds - r[1 + 2 * b].rounds);
+    if (roundsA != roundsB) return roundsB - roundsA;
+    return a - b;
 }
 
+// Print how winner, rounds and survivors respond to each input moving by +-deltaPercent
+void runSensitivityAnalysis(const GameData *data, const char *scenarioJson, double deltaPercent, const BattleOptions *options,
+                            WorkerPool *pool, ResultCache *cache) {
+    static const char *const statNames[SENSITIVITY_STATS] = { "saldiri", "savunma", "saglik", "kritik_sans" };
+    const UnitRegistry *registry = &data->tables->registry;
+    ScenarioSetup setup;
+    if (!parseScenarioSetup(registry, scenarioJson, &setup)) return;
+    SensitivityJob *job = (SensitivityJob *)calloc(1, sizeof(SensitivityJob));
+    if (job == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return;
+    }
+    job->data = data;
+    job->setup = &setup;
+    job->options = options;
+    job->delta = deltaPercent / 100.0;
+    job->cache = cache;
+    for (int side = 0; side < 2; side++) {
+        const Faction *faction = &registry->factions[setup.faction[side]];
+        for (int i = 0; i < faction->unitCount; i++) job->units[job->unitCount++] = faction->firstUnit + i;
+    }
+    int parameterCount = job->unitCount * SENSITIVITY_STATS + 2;
+    job->results = (SensitivityResult *)calloc(1 + 2 * parameterCount, sizeof(SensitivityResult));
+    job->values = (double (*)[2])calloc(parameterCount, sizeof(*job->values));
+    int *order = (int *)malloc(parameterCount * sizeof(int));
+    double start = wallClockSeconds();
+    if (job->results != NULL && job->values != NULL && order != NULL) {
+        job->runCount = 1 + 2 * parameterCount;
+        job->groupSize = battleGroupSize(pool, job->runCount);
+        parallelFor(pool, battleGroupCount(job->runCount, job->groupSize), sensitivityTask, job);
+    } else {
+        job->failed = 1;
+    }
+    double seconds = wallClockSeconds() - start;
+    if (job->failed > 0) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(job->results);
+        free(job->values);
+        free(order);
+        free(job);
+        return;
+    }
 
+    for (int p = 0; p < parameterCount; p++) order[p] = p;
+    sensitivityRanked = job;
+    qsort(order, parameterCount, sizeof(int), sensitivityCompare);
+
+    // Survivor columns are named after the two factions
+    const SensitivityResult *results = job->results;
+    char sideNames[2][24], leftHeaders[2][40];
+    for (int side = 0; side < 2; side++) {
+        const char *label = registry->factions[setup.faction[side]].cogulEtiket;
+        size_t n = 0;
+        for (; label[n] != '\0' && n + 1 < sizeof(sideNames[side]); n++) sideNames[side][n] = (char)tolower((unsigned char)label[n]);
+        sideNames[side][n] = '\0';
+        snprintf(leftHeaders[side], sizeof(leftHeaders[side]), "%s left -/+", label);
+    }
+    printf("Sensitivity analysis: +-%g%% on %d inputs, %d battles, %d threads, %.3f s\n", deltaPercent,
+           parameterCount, 1 + 2 * parameterCount, pool != NULL ? pool->threadCount + 1 : 1, seconds);
+    printf("Baseline: winner %s, %d rounds, %lld %s and %lld %s left\n", scenarioOutcomeName(data, &setup, results[0].outcome),
+           results[0].rounds, results[0].left[SIDE_HUMAN], sideNames[SIDE_HUMAN], results[0].left[SIDE_ORC], sideNames[SIDE_ORC]);
+    printf("Rank  %-32s %17s  %-15s %11s  %15s  %15s\n", "Input", "Value -/+", "Winner -/+", "Rounds -/+", leftHeaders[SIDE_HUMAN], leftHeaders[SIDE_ORC]);
+    int unitParameters = job->unitCount * SENSITIVITY_STATS;
+    for (int r = 0; r < parameterCount; r++) {
+        int p = order[r];
+        const SensitivityResult *low = &results[1 + 2 * p], *high = &results[2 + 2 * p];
+        char name[64], values[40], winners[64];
+        if (p < unitParameters) {
+            snprintf(name, sizeof(name), "%s.%s", registry->units[job->units[p / SENSITIVITY_STATS]].key, statNames[p % SENSITIVITY_STATS]);
+            snprintf(values, sizeof(values), "%.0f/%.0f", job->values[p][0], job->values[p][1]);
+        } else {
+            snprintf(name, sizeof(name), p == unitParameters ? "fatigue_rate" : "fatigue_frequency");
+            snprintf(values, sizeof(values), p == unitParameters ? "%.3f/%.3f" : "%.0f/%.0f", job->values[p][0], job->values[p][1]);
+        }
+        snprintf(winners, sizeof(winners), "%s/%s%s", scenarioOutcomeName(data, &setup, low->outcome),
+                 scenarioOutcomeName(data, &setup, high->outcome),
+                 low->outcome != results[0].outcome || high->outcome != results[0].outcome ? " *" : "");
+        printf("%4d  %-32s %17s  %-15s %5d/%-5d  %7lld/%-7lld  %7lld/%-7lld\n", r + 1, name, values, winners,
+               low->rounds, high->rounds, low->left[SIDE_HUMAN], high->left[SIDE_HUMAN], low->left[SIDE_ORC], high->left[SIDE_ORC]);
+    }
+    printf("* the winner differs from the baseline\n");
+    free(job->results);
+    free(job->values);
+    free(order);
+    free(job);
+}
 
 // Function to select and download the scenario based on user's choice
-const char* selectScenario() {
-    int choice;
-    printf("Please choose a scenario (1-10):\n");
-    if (scanf("%d", &choice) != 1) {
-        fprintf(stderr, "Invalid input. Defaulting to Scenario 1.\n");
-        return "https://yapbenzet.org.tr/1.json";
+// A choice > 0 (e.g. from --scenario) skips the interactive prompt
+const char* selectScenario(int choice) {
+    if (choice <= 0) {
+        printf("Please choose a scenario (1-10):\n");
+        if (scanf("%d", &choice) != 1) {
+            fprintf(stderr, "Invalid input. Defaulting to Scenario 1.\n");
+            return "https://yapbenzet.org.tr/1.json";
+        }
     }
 
     switch(choice) {
@@ -764,6 +5410,196 @@ const char* selectScenario() {
     }
 }
 
+// Scenario prefetch
+// Fetches a list of scenario URLs at the same time through one curl multi
+// handle, so connections (and their DNS, TCP and TLS setup) are reused
+// across requests to the same host. At most 'parallel' requests are in
+// flight; each finished easy handle is reset and takes the next URL. Every
+// request goes through the scenario cache like a single download and has its
+// own timeout. Bodies can also be written to a directory, e.g. as input for --batch.
+
+#define PREFETCH_DEFAULT_PARALLEL 8
+#define PREFETCH_DEFAULT_TIMEOUT 30     // Seconds per request
+
+typedef struct {
+    CURL *curl;
+    ScenarioFetch fetch;
+    int url;                 // Index in the URL list, -1 = idle
+} PrefetchSlot;
+
+// Read the URL list: one URL per line of 'listPath' ("-" = stdin), or the
+// ten numbered scenarios for "all". Returns the count, or -1 if it cannot be read.
+static int prefetchReadList(const char *listPath, char ***urls) {
+    int count = 0, capacity = 16;
+    *urls = (char **)malloc(capacity * sizeof(char *));
+    if (*urls == NULL) return -1;
+    if (strcmp(listPath, "all") == 0) {
+        for (int choice = 1; choice <= 10; choice++) (*urls)[count++] = strdup(selectScenario(choice));
+        return count;
+    }
+    FILE *input = strcmp(listPath, "-") == 0 ? stdin : fopen(listPath, "r");
+    if (input == NULL) {
+        free(*urls);
+        return -1;
+    }
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    while (batchReadLine(input, &line, &lineCapacity)) {
+        char *url = line + strspn(line, " \t");
+        url[strcspn(url, " \t\r\n")] = '\0';
+        if (url[0] == '\0' || url[0] == '#') continue;
+        if (count == capacity) {
+            char **grown = (char **)realloc(*urls, capacity * 2 * sizeof(char *));
+            if (grown == NULL) break;
+            *urls = grown;
+            capacity *= 2;
+        }
+        (*urls)[count++] = strdup(url);
+    }
+    free(line);
+    if (input != stdin) fclose(input);
+    return count;
+}
+
+// Name a prefetched body is written under: the last path segment of its URL
+// (query dropped), or scenario_N.json if there is none
+static void prefetchOutputName(const char *url, int index, char *name, size_t nameSize) {
+    const char *path = strstr(url, "://");
+    path = path != NULL ? strchr(path + 3, '/') : NULL;
+    name[0] = '\0';
+    if (path != NULL) {
+        size_t end = strcspn(path, "?#");
+        size_t start = end;
+        while (start > 0 && path[start - 1] != '/') start--;
+        if (end > start && end - start < nameSize) {
+            memcpy(name, path + start, end - start);
+            name[end - start] = '\0';
+        }
+    }
+    if (name[0] == '\0') snprintf(name, nameSize, "scenario_%d.json", index + 1);
+}
+
+// Files the 'count' prefetched bodies are written to, in list order. A name
+// an earlier URL already took gets the URL's number appended before the
+// extension (a/1.json, b/1.json -> 1.json, 1_2.json). NULL if out of memory.
+static char **prefetchOutputPaths(const char *directory, char **urls, int count) {
+    char **paths = (char **)calloc(count > 0 ? count : 1, sizeof(char *));
+    if (paths == NULL) return NULL;
+    for (int i = 0; i < count; i++) {
+        char name[256];
+        prefetchOutputName(urls[i], i, name, sizeof(name));
+        char *extension = strrchr(name, '.');
+        int stem = extension != NULL ? (int)(extension - name) : (int)strlen(name);
+        char path[1024];
+        batchJoinPath(path, sizeof(path), directory, name);
+        for (int suffix = i + 1, taken = 0; taken < i; taken++) {
+            if (strcmp(paths[taken], path) != 0) continue;
+            char unique[300];
+            snprintf(unique, sizeof(unique), "%.*s_%d%s", stem, name, suffix++, name + stem);
+            batchJoinPath(path, sizeof(path), directory, unique);
+            taken = -1;      // Check the new name against every earlier one again
+        }
+        if ((paths[i] = strdup(path)) == NULL) {
+            while (i-- > 0) free(paths[i]);
+            free(paths);
+            return NULL;
+        }
+    }
+    return paths;
+}
+
+// Hand URL 'url' to the idle 'slot' and add it to the multi handle
+static void prefetchStart(CURLM *multi, PrefetchSlot *slot, ScenarioCache *cache, char **urls, int url, long timeoutSeconds) {
+    slot->url = url;
+    curl_easy_reset(slot->curl);
+    scenarioFetchBegin(cache, &slot->fetch, slot->curl, urls[url]);
+    curl_easy_setopt(slot->curl, CURLOPT_TIMEOUT, timeoutSeconds);
+    curl_easy_setopt(slot->curl, CURLOPT_PRIVATE, (void *)slot);
+    curl_multi_add_handle(multi, slot->curl);
+}
+
+// Fetch every URL of 'listPath' with up to 'parallel' requests in flight
+// into 'cache' (NULL = none) and, if 'outputDirectory' is set, into files
+// there. Returns the process exit code.
+int runPrefetch(const char *listPath, const char *outputDirectory, int parallel, int timeoutSeconds, ScenarioCache *cache) {
+    char **urls;
+    int count = prefetchReadList(listPath, &urls);
+    if (count < 0) {
+        fprintf(stderr, "Cannot open prefetch list: %s\n", listPath);
+        return EXIT_FAILURE;
+    }
+    if (parallel < 1) parallel = 1;
+    if (parallel > count && count > 0) parallel = count;
+    char **paths = NULL;
+    if (outputDirectory != NULL) {
+        CreateDirectoryA(outputDirectory, NULL);
+        paths = prefetchOutputPaths(outputDirectory, urls, count);
+    }
+
+    CURLM *multi = curl_multi_init();
+    PrefetchSlot *slots = (PrefetchSlot *)calloc(parallel, sizeof(PrefetchSlot));
+    bool ok = multi != NULL && slots != NULL && (outputDirectory == NULL || paths != NULL);
+    for (int s = 0; s < parallel && ok; s++) {
+        slots[s].url = -1;
+        ok = (slots[s].curl = curl_easy_init()) != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Curl initialization failed!\n");
+    } else {
+        curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)parallel);
+    }
+
+    double start = wallClockSeconds();
+    int next = 0, active = 0, failed = 0;
+    for (int s = 0; s < parallel && next < count && ok; s++) {
+        prefetchStart(multi, &slots[s], cache, urls, next++, timeoutSeconds);
+        active++;
+    }
+    while (active > 0) {
+        int running;
+        curl_multi_perform(multi, &running);
+        CURLMsg *message;
+        int queued;
+        while ((message = curl_multi_info_read(multi, &queued)) != NULL) {
+            if (message->msg != CURLMSG_DONE) continue;
+            PrefetchSlot *slot;
+            long status = 0;
+            double seconds = 0.0;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char **)&slot);
+            curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+            curl_easy_getinfo(message->easy_handle, CURLINFO_TOTAL_TIME, &seconds);
+            CURLcode result = message->data.result;
+            curl_multi_remove_handle(multi, slot->curl);
+
+            bool fetched = scenarioFetchEnd(cache, &slot->fetch, result, status, paths != NULL ? paths[slot->url] : NULL);
+            if (!fetched) failed++;
+            printf("%4ld %8.0f ms  %s%s\n", status, seconds * 1000.0, urls[slot->url], fetched ? "" : "  (failed)");
+            active--;
+            slot->url = -1;
+            if (next < count) {
+                prefetchStart(multi, slot, cache, urls, next++, timeoutSeconds);
+                active++;
+            }
+        }
+        if (active > 0) curl_multi_poll(multi, NULL, 0, 1000, NULL);
+    }
+    double seconds = wallClockSeconds() - start;
+    fprintf(stderr, "Prefetch: %d URLs, %d failed, %d in flight at most, %.3f s\n", count, failed, parallel, seconds);
+
+    for (int s = 0; slots != NULL && s < parallel; s++) {
+        if (slots[s].curl != NULL) curl_easy_cleanup(slots[s].curl);
+    }
+    free(slots);
+    if (multi != NULL) curl_multi_cleanup(multi);
+    for (int i = 0; i < count; i++) {
+        if (paths != NULL) free(paths[i]);
+        free(urls[i]);
+    }
+    free(paths);
+    free(urls);
+    return ok && failed == 0 ? 0 : EXIT_FAILURE;
+}
+
 // Function to draw the grid
 void drawGrid(int cellSize, int rows, int cols) {
     for (int i = 0; i <= cols; i++) {
@@ -883,243 +5719,578 @@ void placeUnitsInGrid(Birim *birimler, int birimCount, int cellSize, int startRo
     }
 }
 
-int main() {
-    // Seed the random number generator
-    srand(time(NULL));
-    int orkAttackIndex = 0;
-    int insanAttackIndex = 0;
-    // Initialize cURL
-    curl_global_init(CURL_GLOBAL_ALL);
+// Parsed command-line options
+typedef struct {
+    bool headless;            // --headless: no window, no textures, rounds run at full CPU speed
+    int scenarioChoice;       // --scenario N: skip the interactive prompt (0 = ask)
+    const char *scenarioFile; // --scenario-file PATH: use a local scenario instead of downloading
+    const char *scenarioUrl;  // --scenario-url URL: download this scenario instead of a numbered one
+    const char *scenarioCacheDir; // --scenario-cache DIR: keep downloads there (NULL = --no-scenario-cache)
+    int scenarioCacheKb;      // --scenario-cache-size KB: most kilobytes of scenario bodies kept
+    const char *prefetchList; // --prefetch LIST: fetch every URL of LIST ("all" = scenarios 1-10) and exit
+    const char *prefetchOutput; // --prefetch-output DIR: also write the prefetched scenarios there
+    int prefetchParallel;     // --prefetch-parallel N: most requests in flight (default 8)
+    int prefetchTimeout;      // --prefetch-timeout S: seconds per request (default 30)
+    CasualtyMode casualtyMode; // --casualties single|bulk
+    bool skipQuietRounds;      // --skip-quiet-rounds: jump over rounds without events
+    int decideCheckInterval;   // --decide-every N: stop once the winner is certain
+    bool finishAfterDecided;   // --finish-exact: keep going after that for exact counts
+    bool estimateOnly;         // --estimate: analytic estimate instead of a simulation
+    bool calibrateEstimator;   // --calibrate-estimator: estimator vs engine on scaled armies
+    int batchBenchmark;        // --batch-benchmark N: scalar vs lockstep batch engine on N battles
+    bool simultaneousRounds;   // --simultaneous: both armies attack from the start-of-round state
+    int threadCount;           // --threads N: worker threads (0 = one per processor)
+    int parallelBenchmark;     // --parallel-benchmark K: simultaneous rounds, 1 vs N threads, K copies of each unit
+    const char *batchInput;    // --batch PATH: play every scenario of a directory or JSONL file ("-" = stdin)
+    const char *batchOutput;   // --batch-output PATH: JSONL results (default stdout)
+    bool randomCrits;          // --random-crits: crits are kritikSans% draws
+    bool seedGiven;            // --seed N: seed of the crit draws (default: current time)
+    unsigned long long int seed;
+    int monteCarlo;            // --monte-carlo N: win probabilities over N random-crit replicas
+    int optimizeSide;          // --optimize human|orc: rank every loadout of that side (-1 = off)
+    int minArmySide;           // --min-army human|orc: smallest winning army of that side (-1 = off)
+    double unitCosts[UNIT_REGISTRY_MAX_UNITS]; // --unit-costs A,B,...: cost per unit of each type for --min-army (default 1)
+    bool sensitivity;          // --sensitivity: replay with every input stat moved by -/+ delta
+    double sensitivityDelta;   // --sensitivity-delta P: delta in percent (default 10)
+    const char *resultCachePath; // --result-cache PATH: keep battle results in this file
+    int resultCacheSize;       // --result-cache-size N: most entries kept (default 10000)
+    int fatigueFrequency;      // --fatigue-every N: fatigue every N rounds (0 = default)
+    double fatiguePercent;     // --fatigue-percent P: stat loss per fatigue in percent (-1 = default)
+    int maxRounds;             // --max-rounds N: round limit (0 = default)
+    const char *checkpointPath; // --checkpoint PATH: save the battle state there while it runs
+    int checkpointEvery;       // --checkpoint-every N: rounds between checkpoints (default 1000)
+    const char *resumePath;    // --resume/--fork PATH: continue from a checkpoint instead of a scenario
+    bool forkOptions;          // --fork: continue with this command line's rules, not the saved ones
+    const char *keyframePath;  // --keyframes PATH: reuse the rounds an earlier run shares with this one
+    int keyframeEvery;         // --keyframe-every N: rounds between keyframes (default 100)
+    const char *dataBundlePath; // --data-bundle PATH: compiled data files (default C:\json\game_data.bin)
+    bool compileData;          // --compile-data: write the data bundle and exit
+} CommandLineOptions;
+
+// Function to print command-line help
+void printUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  --headless              run without a window at full speed\n");
+    fprintf(stderr, "  --scenario N            scenario number 1-10 (skips the prompt)\n");
+    fprintf(stderr, "  --scenario-file PATH    use a local scenario file instead of downloading\n");
+    fprintf(stderr, "  --scenario-url URL      download this scenario instead of a numbered one\n");
+    fprintf(stderr, "  --scenario-cache DIR    keep downloaded scenarios there, revalidate them and use them offline (default %s)\n", SCENARIO_CACHE_DEFAULT_DIR);
+    fprintf(stderr, "  --scenario-cache-size KB  most kilobytes of scenarios kept in the cache (default %d)\n", SCENARIO_CACHE_DEFAULT_KB);
+    fprintf(stderr, "  --no-scenario-cache     always download the scenario, keep nothing\n");
+    fprintf(stderr, "  --prefetch LIST         fetch every URL in LIST (one per line, - = stdin, all = 1-10) at once and exit\n");
+    fprintf(stderr, "  --prefetch-output DIR   also write the prefetched scenarios to DIR (e.g. for --batch)\n");
+    fprintf(stderr, "  --prefetch-parallel N   most prefetch requests in flight (default %d)\n", PREFETCH_DEFAULT_PARALLEL);
+    fprintf(stderr, "  --prefetch-timeout S    seconds allowed per prefetch request (default %d)\n", PREFETCH_DEFAULT_TIMEOUT);
+    fprintf(stderr, "  --casualties single|bulk  one death per hit (default) or damage / saglik deaths\n");
+    fprintf(stderr, "  --skip-quiet-rounds     jump over rounds without fatigue, crits or deaths\n");
+    fprintf(stderr, "  --decide-every N        every N rounds, stop if the winner is already certain\n");
+    fprintf(stderr, "  --finish-exact          with --decide-every, still play out for exact counts\n");
+    fprintf(stderr, "  --estimate              print an analytic (Lanchester) estimate, no simulation\n");
+    fprintf(stderr, "  --calibrate-estimator   compare the estimate with the engine on scaled armies\n");
+    fprintf(stderr, "  --batch-benchmark N     time the scalar and batch engines on N scaled battles\n");
+    fprintf(stderr, "  --simultaneous          resolve both armies' attacks at once from the round's start\n");
+    fprintf(stderr, "  --threads N             worker threads (default: one per processor)\n");
+    fprintf(stderr, "  --parallel-benchmark K  time simultaneous rounds with every unit type repeated K times\n");
+    fprintf(stderr, "  --batch PATH            play every scenario in a directory or JSONL file (- = stdin)\n");
+    fprintf(stderr, "  --batch-output PATH     write the batch results there instead of stdout\n");
+    fprintf(stderr, "  --random-crits          roll each crit with kritikSans%% chance instead of scheduling it\n");
+    fprintf(stderr, "  --seed N                seed for random crits (default: current time)\n");
+    fprintf(stderr, "  --monte-carlo N         win probabilities with confidence intervals over N replicas\n");
+    fprintf(stderr, "  --optimize human|orc    rank every hero/creature/research loadout of that side\n");
+    fprintf(stderr, "  --min-army human|orc    smallest counts of that side that still win\n");
+    fprintf(stderr, "  --unit-costs A,B,...    cost per unit of each type for --min-army (default 1 each)\n");
+    fprintf(stderr, "  --sensitivity           rank unit stats and fatigue settings by their effect on the result\n");
+    fprintf(stderr, "  --sensitivity-delta P   change each input by -/+ P percent (default 10)\n");
+    fprintf(stderr, "  --result-cache PATH     reuse results of identical battles across runs (batch and analysis modes)\n");
+    fprintf(stderr, "  --result-cache-size N   most results kept in the cache (default 10000)\n");
+    fprintf(stderr, "  --fatigue-every N       apply fatigue every N rounds (default 5)\n");
+    fprintf(stderr, "  --fatigue-percent P     attack and defence lost per fatigue in percent (default 10)\n");
+    fprintf(stderr, "  --max-rounds N          end the battle after N rounds, winner by remaining units (default 10000)\n");
+    fprintf(stderr, "  --checkpoint PATH       save the battle state while it runs (%%d in PATH = round number)\n");
+    fprintf(stderr, "  --checkpoint-every N    rounds between checkpoints (default 1000)\n");
+    fprintf(stderr, "  --resume PATH           continue a battle from a checkpoint with its saved rules\n");
+    fprintf(stderr, "  --fork PATH             continue a battle from a checkpoint with the rules given here\n");
+    fprintf(stderr, "  --keyframes PATH        keep keyframes there and replay only rounds changed options can affect\n");
+    fprintf(stderr, "  --keyframe-every N      rounds between keyframes (default 100)\n");
+    fprintf(stderr, "  --compile-data          compile the JSON data files into the data bundle and exit\n");
+    fprintf(stderr, "  --data-bundle PATH      data bundle to use while it is up to date (default %s)\n", DATA_BUNDLE_DEFAULT_PATH);
+}
 
-    // Open the log file
-    FILE *logFile = fopen("savas_sim.txt", "w");
-    if (!logFile) {
-        fprintf(stderr, "Failed to open log file.\n");
-        curl_global_cleanup();
-        return EXIT_FAILURE;
+// Function to parse command-line flags
+bool parseCommandLine(int argc, char *argv[], CommandLineOptions *options) {
+    memset(options, 0, sizeof(*options));
+    options->optimizeSide = -1;
+    options->minArmySide = -1;
+    options->sensitivityDelta = 10.0;
+    options->resultCacheSize = 10000;
+    options->fatiguePercent = -1.0;
+    options->checkpointEvery = 1000;
+    options->keyframeEvery = 100;
+    options->dataBundlePath = DATA_BUNDLE_DEFAULT_PATH;
+    options->scenarioCacheDir = SCENARIO_CACHE_DEFAULT_DIR;
+    options->scenarioCacheKb = SCENARIO_CACHE_DEFAULT_KB;
+    options->prefetchParallel = PREFETCH_DEFAULT_PARALLEL;
+    options->prefetchTimeout = PREFETCH_DEFAULT_TIMEOUT;
+    for (int u = 0; u < UNIT_REGISTRY_MAX_UNITS; u++) {
+        options->unitCosts[u] = 1.0;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            options->headless = true;
+        } else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            options->scenarioChoice = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scenario-file") == 0 && i + 1 < argc) {
+            options->scenarioFile = argv[++i];
+        } else if (strcmp(argv[i], "--skip-quiet-rounds") == 0) {
+            options->skipQuietRounds = true;
+        } else if (strcmp(argv[i], "--decide-every") == 0 && i + 1 < argc) {
+            options->decideCheckInterval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--finish-exact") == 0) {
+            options->finishAfterDecided = true;
+        } else if (strcmp(argv[i], "--estimate") == 0) {
+            options->estimateOnly = true;
+        } else if (strcmp(argv[i], "--calibrate-estimator") == 0) {
+            options->calibrateEstimator = true;
+        } else if (strcmp(argv[i], "--batch-benchmark") == 0 && i + 1 < argc) {
+            options->batchBenchmark = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--simultaneous") == 0) {
+            options->simultaneousRounds = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options->threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--parallel-benchmark") == 0 && i + 1 < argc) {
+            options->parallelBenchmark = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            options->batchInput = argv[++i];
+        } else if (strcmp(argv[i], "--batch-output") == 0 && i + 1 < argc) {
+            options->batchOutput = argv[++i];
+        } else if (strcmp(argv[i], "--random-crits") == 0) {
+            options->randomCrits = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->seedGiven = true;
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--monte-carlo") == 0 && i + 1 < argc) {
+            options->monteCarlo = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--optimize") == 0 || strcmp(argv[i], "--min-army") == 0) && i + 1 < argc) {
+            int *side = strcmp(argv[i], "--optimize") == 0 ? &options->optimizeSide : &options->minArmySide;
+            i++;
+            if (strcmp(argv[i], "human") == 0) {
+                *side = SIDE_HUMAN;
+            } else if (strcmp(argv[i], "orc") == 0) {
+                *side = SIDE_ORC;
+            } else {
+                fprintf(stderr, "Unknown side: %s (expected human or orc)\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--result-cache") == 0 && i + 1 < argc) {
+            options->resultCachePath = argv[++i];
+        } else if (strcmp(argv[i], "--result-cache-size") == 0 && i + 1 < argc) {
+            options->resultCacheSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fatigue-every") == 0 && i + 1 < argc) {
+            options->fatigueFrequency = atoi(argv[++i]);
+            if (options->fatigueFrequency <= 0) {
+                fprintf(stderr, "--fatigue-every needs a positive number of rounds\n");
+                return false;
+            }
+        } else if (strcmp(argv[i], "--fatigue-percent") == 0 && i + 1 < argc) {
+            options->fatiguePercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-rounds") == 0 && i + 1 < argc) {
+            options->maxRounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            options->checkpointPath = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            options->checkpointEvery = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--resume") == 0 || strcmp(argv[i], "--fork") == 0) && i + 1 < argc) {
+            options->forkOptions = strcmp(argv[i], "--fork") == 0;
+            options->resumePath = argv[++i];
+        } else if (strcmp(argv[i], "--keyframes") == 0 && i + 1 < argc) {
+            options->keyframePath = argv[++i];
+        } else if (strcmp(argv[i], "--keyframe-every") == 0 && i + 1 < argc) {
+            options->keyframeEvery = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--compile-data") == 0) {
+            options->compileData = true;
+        } else if (strcmp(argv[i], "--data-bundle") == 0 && i + 1 < argc) {
+            options->dataBundlePath = argv[++i];
+        } else if (strcmp(argv[i], "--scenario-url") == 0 && i + 1 < argc) {
+            options->scenarioUrl = argv[++i];
+        } else if (strcmp(argv[i], "--scenario-cache") == 0 && i + 1 < argc) {
+            options->scenarioCacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--scenario-cache-size") == 0 && i + 1 < argc) {
+            options->scenarioCacheKb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-scenario-cache") == 0) {
+            options->scenarioCacheDir = NULL;
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+            options->prefetchList = argv[++i];
+        } else if (strcmp(argv[i], "--prefetch-output") == 0 && i + 1 < argc) {
+            options->prefetchOutput = argv[++i];
+        } else if (strcmp(argv[i], "--prefetch-parallel") == 0 && i + 1 < argc) {
+            options->prefetchParallel = atoi(argv[++i]);
+            if (options->prefetchParallel <= 0) {
+                fprintf(stderr, "Invalid prefetch parallelism: %s (expected at least 1)\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--prefetch-timeout") == 0 && i + 1 < argc) {
+            options->prefetchTimeout = atoi(argv[++i]);
+            if (options->prefetchTimeout <= 0) {
+                fprintf(stderr, "Invalid prefetch timeout: %s (expected seconds > 0)\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--sensitivity") == 0) {
+            options->sensitivity = true;
+        } else if (strcmp(argv[i], "--sensitivity-delta") == 0 && i + 1 < argc) {
+            options->sensitivityDelta = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--unit-costs") == 0 && i + 1 < argc) {
+            char *cost = argv[++i];
+            for (int u = 0; u < UNIT_REGISTRY_MAX_UNITS && *cost != '\0'; u++) {
+                options->unitCosts[u] = strtod(cost, &cost);
+                if (*cost == ',') cost++;
+            }
+        } else if (strcmp(argv[i], "--casualties") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "bulk") == 0) {
+                options->casualtyMode = CASUALTY_BULK;
+            } else if (strcmp(argv[i], "single") == 0) {
+                options->casualtyMode = CASUALTY_ONE_PER_HIT;
+            } else {
+                fprintf(stderr, "Unknown casualty mode: %s (expected single or bulk)\n", argv[i]);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    // These modes rebuild the armies from the scenario, which a checkpoint does not have
+    if (options->resumePath != NULL && (options->optimizeSide >= 0 || options->sensitivity)) {
+        fprintf(stderr, "--resume and --fork cannot be combined with --optimize or --sensitivity\n");
+        return false;
+    }
+    if (options->resumePath != NULL && options->keyframePath != NULL) {
+        fprintf(stderr, "--keyframes cannot be combined with --resume or --fork\n");
+        return false;
+    }
+    return true;
+}
+
+// Battle options selected on the command line
+void battleOptionsFromCommandLine(const CommandLineOptions *options, BattleOptions *battleOptions) {
+    battleDefaultOptions(battleOptions);
+    battleOptions->casualtyMode = options->casualtyMode;
+    battleOptions->skipQuietRounds = options->skipQuietRounds;
+    battleOptions->decideCheckInterval = options->decideCheckInterval;
+    battleOptions->finishAfterDecided = options->finishAfterDecided;
+    battleOptions->simultaneousRounds = options->simultaneousRounds;
+    battleOptions->randomCrits = options->randomCrits;
+    battleOptions->seed = options->seed;
+    if (options->fatigueFrequency > 0) {
+        battleOptions->fatigueFrequency = options->fatigueFrequency;
+    }
+    if (options->fatiguePercent >= 0) {
+        battleOptions->fatiguePercentage = (float)(options->fatiguePercent / 100.0);
+    }
+    if (options->maxRounds > 0) {
+        battleOptions->maxRounds = options->maxRounds;
     }
+}
+
+// Read the data files and the selected scenario (downloading it unless a
+// local file was given) and set up its battle. The data files load while a
+// download runs; for a local scenario only the files it refers to are read.
+bool loadScenarioBattle(const CommandLineOptions *options, GameData *gameData, char **scenarioJson,
+                        const BattleOptions *battleOptions, FILE *logFile, BattleContext *battle) {
+    GameDataLoader loader;
+    bool loading = false;
 
-    // Select and download the scenario
-    const char* scenarioUrl = selectScenario();
+    // Select and download the scenario (unless a local file was given)
     const char* output_file = "selected_scenario.json";
+    if (options->scenarioFile == NULL) {
+        const char* scenarioUrl = options->scenarioUrl != NULL ? options->scenarioUrl : selectScenario(options->scenarioChoice);
+        gameDataLoadStart(&loader, gameData, GAME_DATA_ALL, options->dataBundlePath);
+        loading = true;
+
+        // Download the selected scenario, revalidating the cached copy if there is one
+        int downloadStatus;
+        if (options->scenarioCacheDir != NULL) {
+            ScenarioCache cache;
+            scenarioCacheOpen(&cache, options->scenarioCacheDir, (long long int)options->scenarioCacheKb * 1024);
+            downloadStatus = scenarioCacheFetch(&cache, scenarioUrl, output_file);
+            scenarioCachePrintStats(&cache);
+            scenarioCacheClose(&cache);
+        } else {
+            downloadStatus = download_json(scenarioUrl, output_file);
+        }
+        if (downloadStatus != 0) {
+            fprintf(stderr, "Failed to download the scenario.\n");
+            if (gameDataLoadFinish(&loader)) freeGameData(gameData);
+            return false;
+        }
+    }
 
-    // Download the selected scenario
-    if (download_json(scenarioUrl, output_file) != 0) {
-        fprintf(stderr, "Failed to download the scenario.\n");
-        fclose(logFile);
-        curl_global_cleanup();
-        return 1;
+    const char* scenarioFilePath = options->scenarioFile != NULL ? options->scenarioFile : output_file;
+
+    *scenarioJson = readJsonFromFile(scenarioFilePath);
+    if (*scenarioJson == NULL) {
+        fprintf(stderr, "Failed to read scenario JSON.\n");
+        if (loading && gameDataLoadFinish(&loader)) freeGameData(gameData);
+        return false;
+    } else {
+        printf("Scenario JSON loaded successfully.\n");
+    }
+
+    // Read JSON files (the optimizer tries every hero, creature and research level)
+    if (!loading) {
+        gameDataLoadStart(&loader, gameData, options->optimizeSide >= 0 ? GAME_DATA_ALL : scenarioDataNeeds(*scenarioJson),
+                          options->dataBundlePath);
+    }
+    if (!gameDataLoadFinish(&loader)) {
+        free(*scenarioJson);
+        return false;
+    }
+    ScenarioSetup setup;
+    if (!parseScenarioSetup(&gameData->tables->registry, *scenarioJson, &setup)) {
+        fprintf(stderr, "Scenario JSON does not have armies of two factions from unit_types.json.\n");
+        freeGameData(gameData);
+        free(*scenarioJson);
+        return false;
     }
 
-    // Paths to JSON files
-    const char* unitTypesFilePath = "C:\\json\\unit_types.json";
-    const char* heroesFilePath = "C:\\json\\heroes.json";
-    const char* creaturesFilePath = "C:\\json\\creatures.json";
-    const char* researchFilePath = "C:\\json\\research.json";
-    const char* scenarioFilePath = "selected_scenario.json";
+    // Apply unit types, heroes, creatures and research to the scenario's armies
+    ArmyStats stats = gameData->tables->baseStats;
+    applyLoadout(gameData, &setup, &stats);
+    if (!setupBattle(battle, gameData, &setup, &stats, battleOptions, logFile)) {
+        freeGameData(gameData);
+        free(*scenarioJson);
+        return false;
+    }
+    return true;
+}
 
-    // Read JSON files
-    char* unitTypesJson = readJsonFromFile(unitTypesFilePath);
-    if (unitTypesJson == NULL) {
-        fprintf(stderr, "Failed to read unit types JSON.\n");
-        fclose(logFile);
-        curl_global_cleanup();
+// Name of the checkpoint file for 'round': "%d" in the pattern is replaced by the round
+void checkpointFileName(char *dest, size_t destSize, const char *pattern, int round) {
+    const char *marker = strstr(pattern, "%d");
+    if (marker == NULL) {
+        snprintf(dest, destSize, "%s", pattern);
+    } else {
+        snprintf(dest, destSize, "%.*s%d%s", (int)(marker - pattern), pattern, round, marker + 2);
+    }
+}
+
+// Write a checkpoint of 'battle' if it is due (or 'force' is set)
+void battleCheckpointIfDue(const BattleContext *battle, const CommandLineOptions *options, int *nextCheckpoint, bool force) {
+    if (options->checkpointPath == NULL || (!force && battle->roundsPlayed < *nextCheckpoint)) return;
+    char path[1024];
+    checkpointFileName(path, sizeof(path), options->checkpointPath, battle->roundsPlayed);
+    battleWriteCheckpoint(battle, path);
+    *nextCheckpoint = battle->roundsPlayed + (options->checkpointEvery > 0 ? options->checkpointEvery : 1);
+}
+
+int main(int argc, char *argv[]) {
+    CommandLineOptions options;
+    if (!parseCommandLine(argc, argv, &options)) {
         return EXIT_FAILURE;
     }
+    bool headless = options.headless;
 
-    char* heroesJson = readJsonFromFile(heroesFilePath);
-    if (heroesJson == NULL) {
-        fprintf(stderr, "Failed to read heroes JSON.\n");
-        free(unitTypesJson);
-        fclose(logFile);
+    // Seed for random crits; printed with the results so a run can be repeated
+    if (!options.seedGiven) {
+        options.seed = (unsigned long long int)time(NULL);
+    }
+    // Compile the data files and stop
+    if (options.compileData) {
+        if (!dataBundleCompile(options.dataBundlePath)) {
+            return EXIT_FAILURE;
+        }
+        printf("Data bundle written to %s.\n", options.dataBundlePath);
+        return EXIT_SUCCESS;
+    }
+
+    // Initialize cURL
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    // Prefetch mode refreshes the scenario cache (and optionally a directory) and stops
+    if (options.prefetchList != NULL) {
+        ScenarioCache scenarioCache;
+        bool useCache = options.scenarioCacheDir != NULL &&
+                        scenarioCacheOpen(&scenarioCache, options.scenarioCacheDir, (long long int)options.scenarioCacheKb * 1024);
+        int status = runPrefetch(options.prefetchList, options.prefetchOutput, options.prefetchParallel, options.prefetchTimeout,
+                                 useCache ? &scenarioCache : NULL);
+        if (useCache) {
+            scenarioCachePrintStats(&scenarioCache);
+            scenarioCacheClose(&scenarioCache);
+        }
         curl_global_cleanup();
-        return EXIT_FAILURE;
+        return status;
     }
 
-    char* creaturesJson = readJsonFromFile(creaturesFilePath);
-    if (creaturesJson == NULL) {
-        fprintf(stderr, "Failed to read creatures JSON.\n");
-        free(unitTypesJson);
-        free(heroesJson);
-        fclose(logFile);
+    // Batch mode plays local scenarios only: no log file, no download, no window
+    if (options.batchInput != NULL) {
+        BattleOptions battleOptions;
+        battleOptionsFromCommandLine(&options, &battleOptions);
+        int threadCount = options.threadCount > 0 ? options.threadCount : workerPoolDefaultThreads();
+        ResultCache resultCache;
+        bool useCache = options.resultCachePath != NULL && resultCacheOpen(&resultCache, options.resultCachePath, options.resultCacheSize);
+        int status = runBatch(options.batchInput, options.batchOutput, &battleOptions, threadCount, useCache ? &resultCache : NULL,
+                              options.dataBundlePath);
+        if (useCache) {
+            resultCachePrintStats(&resultCache);
+            resultCacheClose(&resultCache, options.resultCachePath);
+        }
+        curl_global_cleanup();
+        return status;
+    }
+
+    // Open the log file (a resumed battle continues the existing log)
+    FILE *logFile = fopen("savas_sim.txt", options.resumePath != NULL ? "a" : "w");
+    if (!logFile) {
+        fprintf(stderr, "Failed to open log file.\n");
         curl_global_cleanup();
         return EXIT_FAILURE;
     }
 
-    char* researchJson = readJsonFromFile(researchFilePath);
-    if (researchJson == NULL) {
-        fprintf(stderr, "Failed to read research JSON.\n");
-        free(unitTypesJson);
-        free(heroesJson);
-        free(creaturesJson);
+    // Build the armies from the scenario, or take the whole battle from a checkpoint
+    GameData gameData;
+    memset(&gameData, 0, sizeof(gameData));
+    char* scenarioJson = NULL;
+    BattleOptions battleOptions;
+    battleOptionsFromCommandLine(&options, &battleOptions);
+    BattleContext battle;
+    if (options.resumePath != NULL) {
+        if (!battleReadCheckpoint(&battle, options.resumePath, logFile)) {
+            fclose(logFile);
+            curl_global_cleanup();
+            return EXIT_FAILURE;
+        }
+        if (battle.sides[SIDE_HUMAN].birimSayisi > UNIT_REGISTRY_MAX_UNITS || battle.sides[SIDE_ORC].birimSayisi > UNIT_REGISTRY_MAX_UNITS) {
+            fprintf(stderr, "Checkpoint %s has more than %d unit types per army.\n", options.resumePath, UNIT_REGISTRY_MAX_UNITS);
+            battleDestroy(&battle);
+            fclose(logFile);
+            curl_global_cleanup();
+            return EXIT_FAILURE;
+        }
+        if (options.forkOptions) {
+            battleChangeOptions(&battle, &battleOptions);
+        }
+    } else if (!loadScenarioBattle(&options, &gameData, &scenarioJson, &battleOptions, logFile, &battle)) {
         fclose(logFile);
         curl_global_cleanup();
         return EXIT_FAILURE;
     }
 
-    char* scenarioJson = readJsonFromFile(scenarioFilePath);
-    if (scenarioJson == NULL) {
-        fprintf(stderr, "Failed to read scenario JSON.\n");
-        free(unitTypesJson);
-        free(heroesJson);
-        free(creaturesJson);
-        free(researchJson);
+    // Unit records of both armies for drawing, sized from the battle
+    int insanUnitCount = battle.sides[SIDE_HUMAN].birimSayisi;
+    int orkUnitCount = battle.sides[SIDE_ORC].birimSayisi;
+    Birim *insanImparatorlugu = (Birim *)calloc(insanUnitCount + 1, sizeof(Birim));
+    Birim *orkLegionu = (Birim *)calloc(orkUnitCount + 1, sizeof(Birim));
+    if (insanImparatorlugu == NULL || orkLegionu == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(insanImparatorlugu);
+        free(orkLegionu);
+        battleDestroy(&battle);
+        freeGameData(&gameData);
+        free(scenarioJson);
         fclose(logFile);
         curl_global_cleanup();
         return EXIT_FAILURE;
-    } else {
-        printf("Scenario JSON loaded successfully.\n");
+    }
+    battleExportUnits(&battle, SIDE_HUMAN, insanImparatorlugu);
+    battleExportUnits(&battle, SIDE_ORC, orkLegionu);
+
+    // Worker threads, only needed when a round or a set of battles is split across them
+    WorkerPool workerPool;
+    int threadCount = 1;
+    if (options.simultaneousRounds || options.parallelBenchmark > 0 || options.monteCarlo > 0 || options.optimizeSide >= 0 ||
+        options.minArmySide >= 0 || options.sensitivity) {
+        threadCount = options.threadCount > 0 ? options.threadCount : workerPoolDefaultThreads();
+    }
+    workerPoolInit(&workerPool, threadCount);
+    battle.pool = &workerPool;
+
+    // Estimator and benchmark modes never run the scenario battle itself
+    if (options.estimateOnly || options.calibrateEstimator || options.batchBenchmark > 0 || options.parallelBenchmark > 0 ||
+        options.monteCarlo > 0 || options.optimizeSide >= 0 || options.minArmySide >= 0 || options.sensitivity) {
+        ResultCache resultCache;
+        bool useCache = options.resultCachePath != NULL && resultCacheOpen(&resultCache, options.resultCachePath, options.resultCacheSize);
+        if (useCache) {
+            battle.cache = &resultCache;
+        }
+        if (options.estimateOnly) {
+            printBattleEstimate(&battle);
+        } else if (options.calibrateEstimator) {
+            runEstimatorCalibration(&battle);
+        } else if (options.batchBenchmark > 0) {
+            runBatchBenchmark(&battle, options.batchBenchmark);
+        } else if (options.monteCarlo > 0) {
+            runMonteCarlo(&battle, options.monteCarlo, &workerPool);
+        } else if (options.optimizeSide >= 0) {
+            runLoadoutOptimizer(&gameData, scenarioJson, options.optimizeSide, &battleOptions, &workerPool, battle.cache);
+        } else if (options.minArmySide >= 0) {
+            runMinimumArmySearch(&battle, options.minArmySide, options.unitCosts, &workerPool);
+        } else if (options.sensitivity) {
+            runSensitivityAnalysis(&gameData, scenarioJson, options.sensitivityDelta, &battleOptions, &workerPool, battle.cache);
+        } else {
+            runParallelBenchmark(&battle, options.parallelBenchmark, &workerPool);
+        }
+        if (useCache) {
+            resultCachePrintStats(&resultCache);
+            resultCacheClose(&resultCache, options.resultCachePath);
+        }
+        battleDestroy(&battle);
+        workerPoolDestroy(&workerPool);
+        freeGameData(&gameData);
+        free(scenarioJson);
+        free(insanImparatorlugu);
+        free(orkLegionu);
+        fclose(logFile);
+        curl_global_cleanup();
+        return 0;
     }
 
-    // Set up unit attributes for all units
-    int piyadeSaldiri = 0, piyadeSavunma = 0, piyadeSaglik = 0, piyadeKritikSans = 0;
-    int okcuSaldiri = 0, okcuSavunma = 0, okcuSaglik = 0, okcuKritikSans = 0;
-    int suvariSaldiri = 0, suvariSavunma = 0, suvariSaglik = 0, suvariKritikSans = 0;
-    int kusatmaSaldiri = 0, kusatmaSavunma = 0, kusatmaSaglik = 0, kusatmaKritikSans = 0;
-    int orkSaldiri = 0, orkSavunma = 0, orkSaglik = 0, orkKritikSans = 0;
-    int mizrakciSaldiri = 0, mizrakciSavunma = 0, mizrakciSaglik = 0, mizrakciKritikSans = 0;
-    int vargSaldiri = 0, vargSavunma = 0, vargSaglik = 0, vargKritikSans = 0;
-    int trolSaldiri = 0, trolSavunma = 0, trolSaglik = 0, trolKritikSans = 0;
-
-    jsonVerisiniIsleVeBirimOzellikleriniAyarla(unitTypesJson,
-        &piyadeSaldiri, &piyadeSavunma, &piyadeSaglik, &piyadeKritikSans,
-        &okcuSaldiri, &okcuSavunma, &okcuSaglik, &okcuKritikSans,
-        &suvariSaldiri, &suvariSavunma, &suvariSaglik, &suvariKritikSans,
-        &kusatmaSaldiri, &kusatmaSavunma, &kusatmaSaglik, &kusatmaKritikSans,
-        &orkSaldiri, &orkSavunma, &orkSaglik, &orkKritikSans,
-        &mizrakciSaldiri, &mizrakciSavunma, &mizrakciSaglik, &mizrakciKritikSans,
-        &vargSaldiri, &vargSavunma, &vargSaglik, &vargKritikSans,
-        &trolSaldiri, &trolSavunma, &trolSaglik, &trolKritikSans);
-
-    // Arrays to hold unit counts
-    long long int humanUnitCounts[4] = {0}; // Piyadeler, Okular, Svariler, Kuatma Makineleri
-    long long int orcUnitCounts[4] = {0};   // Ork Dvleri, Mzraklar, Varg Binicileri, Troller
-
-    // Hero and creature names
-    char humanHero[50] = {0}, humanCreature[50] = {0};
-    char orcHero[50] = {0}, orcCreature[50] = {0};
-
-    parseScenarioJson(scenarioJson, humanUnitCounts, orcUnitCounts, humanHero, humanCreature, orcHero, orcCreature);
-
-    // Apply hero effects
-    kahramanEtkisiUygula(heroesJson, humanHero, 1,
-        &piyadeSaldiri, &piyadeSavunma, &piyadeKritikSans,
-        &okcuSaldiri, &okcuSavunma, &okcuKritikSans,
-        &suvariSaldiri, &suvariSavunma, &suvariKritikSans,
-        &kusatmaSaldiri, &kusatmaSavunma, &kusatmaKritikSans,
-        &orkSaldiri, &orkSavunma, &orkKritikSans,
-        &mizrakciSaldiri, &mizrakciSavunma, &mizrakciKritikSans,
-        &vargSaldiri, &vargSavunma, &vargKritikSans,
-        &trolSaldiri, &trolSavunma, &trolKritikSans);
-
-    kahramanEtkisiUygula(heroesJson, orcHero, 0,
-        &piyadeSaldiri, &piyadeSavunma, &piyadeKritikSans,
-        &okcuSaldiri, &okcuSavunma, &okcuKritikSans,
-        &suvariSaldiri, &suvariSavunma, &suvariKritikSans,
-        &kusatmaSaldiri, &kusatmaSavunma, &kusatmaKritikSans,
-        &orkSaldiri, &orkSavunma, &orkKritikSans,
-        &mizrakciSaldiri, &mizrakciSavunma, &mizrakciKritikSans,
-        &vargSaldiri, &vargSavunma, &vargKritikSans,
-        &trolSaldiri, &trolSavunma, &trolKritikSans);
-
-    // Apply creature effects
-    canavarEtkisiUygula(creaturesJson, humanCreature, 1,
-        &piyadeSaldiri, &piyadeSavunma, &piyadeKritikSans,
-        &okcuSaldiri, &okcuSavunma, &okcuKritikSans,
-        &suvariSaldiri, &suvariSavunma, &suvariKritikSans,
-        &kusatmaSaldiri, &kusatmaSavunma, &kusatmaKritikSans,
-        &orkSaldiri, &orkSavunma, &orkKritikSans,
-        &mizrakciSaldiri, &mizrakciSavunma, &mizrakciKritikSans,
-        &vargSaldiri, &vargSavunma, &vargKritikSans,
-        &trolSaldiri, &trolSavunma, &trolKritikSans);
-
-    canavarEtkisiUygula(creaturesJson, orcCreature, 0,
-        &piyadeSaldiri, &piyadeSavunma, &piyadeKritikSans,
-        &okcuSaldiri, &okcuSavunma, &okcuKritikSans,
-        &suvariSaldiri, &suvariSavunma, &suvariKritikSans,
-        &kusatmaSaldiri, &kusatmaSavunma, &kusatmaKritikSans,
-        &orkSaldiri, &orkSavunma, &orkKritikSans,
-        &mizrakciSaldiri, &mizrakciSavunma, &mizrakciKritikSans,
-        &vargSaldiri, &vargSavunma, &vargKritikSans,
-        &trolSaldiri, &trolSavunma, &trolKritikSans);
-
-    // Apply research effects
-    int humanDefenseMasteryLevel = extractIntValue(scenarioJson, "\"savunma_ustaligi\"");
-    int orcAttackDevelopmentLevel = extractIntValue(scenarioJson, "\"saldiri_gelistirmesi\"");
-
-    arastirmaEtkisiUygula(researchJson, humanDefenseMasteryLevel, orcAttackDevelopmentLevel,
-        &piyadeSaldiri, &piyadeSavunma,
-        &okcuSaldiri, &okcuSavunma,
-        &suvariSaldiri, &suvariSavunma,
-        &kusatmaSaldiri, &kusatmaSavunma,
-        &orkSaldiri, &orkSavunma,
-        &mizrakciSaldiri, &mizrakciSavunma,
-        &vargSaldiri, &vargSavunma,
-        &trolSaldiri, &trolSavunma);
-
-    // Initialize unit health and counts
-    Birim insanImparatorlugu[4] = {
-        {"Piyadeler", piyadeSaldiri, piyadeSavunma, piyadeSaglik, piyadeSaglik, piyadeKritikSans, humanUnitCounts[0], ORANGE, {0}},
-        {"Okular", okcuSaldiri, okcuSavunma, okcuSaglik, okcuSaglik, okcuKritikSans, humanUnitCounts[1], DARKBLUE, {0}},
-        {"Svariler", suvariSaldiri, suvariSavunma, suvariSaglik, suvariSaglik, suvariKritikSans, humanUnitCounts[2], RED, {0}},
-        {"Kuatma Makineleri", kusatmaSaldiri, kusatmaSavunma, kusatmaSaglik, kusatmaSaglik, kusatmaKritikSans, humanUnitCounts[3], DARKGREEN, {0}}
-    };
-    int insanUnitCount = 4;
-
-    Birim orkLegionu[4] = {
-        {"Ork Dvleri", orkSaldiri, orkSavunma, orkSaglik, orkSaglik, orkKritikSans, orcUnitCounts[0], DARKGRAY, {0}},
-        {"Mzraklar", mizrakciSaldiri, mizrakciSavunma, mizrakciSaglik, mizrakciSaglik, mizrakciKritikSans, orcUnitCounts[1], MAROON, {0}},
-        {"Varg Binicileri", vargSaldiri, vargSavunma, vargSaglik, vargSaglik, vargKritikSans, orcUnitCounts[2], BROWN, {0}},
-        {"Troller", trolSaldiri, trolSavunma, trolSaglik, trolSaglik, trolKritikSans, orcUnitCounts[3], DARKBLUE, {0}}
-    };
-    int orkUnitCount = 4;
-
-    // Initialize Raylib
+    // Initialize Raylib (headless runs never open a window)
     const int ekranGenisligi = 800;
     const int ekranYuksekligi = 800;
-    InitWindow(ekranGenisligi, ekranYuksekligi, "Sava Simlasyonu");
-
-    // Set target FPS
-    SetTargetFPS(60);
-
-    // Load textures AFTER initializing Raylib
-    loadInsanTextures(insanImparatorlugu, insanUnitCount);
-    loadOrkTextures(orkLegionu, orkUnitCount);
-
-    // Initialize attack count arrays
-    int attackCountHuman[4] = {0}; // For Piyadeler, Okular, Svariler, Kuatma Makineleri
-    int critThresholdHuman[4];
-    for(int i = 0; i < 4; i++) {
-        if(insanImparatorlugu[i].kritikSans > 0) {
-            critThresholdHuman[i] = (int)(100.0 / insanImparatorlugu[i].kritikSans);
-            if(critThresholdHuman[i] == 0) critThresholdHuman[i] = INT_MAX; // Prevent division by zero
-        } else {
-            critThresholdHuman[i] = INT_MAX; // No critical hits
-        }
+    if (!headless) {
+        InitWindow(ekranGenisligi, ekranYuksekligi, "Sava Simlasyonu");
+
+        // Set target FPS
+        SetTargetFPS(60);
+
+        // Load textures AFTER initializing Raylib
+        loadInsanTextures(insanImparatorlugu, insanUnitCount);
+        loadOrkTextures(orkLegionu, orkUnitCount);
     }
 
-    int attackCountOrc[4] = {0}; // For Ork Dvleri, Mzraklar, Varg Binicileri, Troller
-    int critThresholdOrc[4];
-    for(int i = 0; i < 4; i++) {
-        if(orkLegionu[i].kritikSans > 0) {
-            critThresholdOrc[i] = (int)(100.0 / orkLegionu[i].kritikSans);
-            if(critThresholdOrc[i] == 0) critThresholdOrc[i] = INT_MAX; // Prevent division by zero
-        } else {
-            critThresholdOrc[i] = INT_MAX; // No critical hits
+    if (options.resumePath != NULL) {
+        fprintf(logFile, "\nBattle resumed from %s at round %d.\n", options.resumePath, battle.roundNumber);
+    } else {
+        fprintf(logFile, "\nBattle Start!\n");
+    }
+    clock_t battleStartTime = clock();
+
+    // Continue from the last keyframe of an earlier run that the changed options cannot have affected
+    KeyframeStore keyframeStore;
+    KeyframeStore *keyframes = NULL;
+    if (options.keyframePath != NULL) {
+        keyframes = &keyframeStore;
+        keyframeStoreInit(keyframes, options.keyframeEvery);
+        keyframeStoreLoad(keyframes, options.keyframePath);
+        int reused = keyframeStoreRestore(keyframes, &battle);
+        if (reused > 0) {
+            fprintf(logFile, "Rounds 1-%d taken from the keyframes in %s.\n", reused, options.keyframePath);
         }
+        fprintf(stderr, "Keyframes: %d rounds reused, replaying from round %d\n", reused, battle.roundNumber);
     }
-
-    // Initialize simulation variables
-    int roundNumber = 1;
-    bool battleOngoing = true;
-    float fatiguePercentage = 0.10f; // Fatigue percentage
-    int fatigueFrequency = 5;        // Apply fatigue every 'fatigueFrequency' rounds
-    int maxRounds = 10000;           // Maximum number of rounds
-
-    fprintf(logFile, "\nBattle Start!\n");
+    int nextCheckpoint = battle.roundsPlayed + options.checkpointEvery;
 
     // Sava simlasyonunu balat
-    while (!WindowShouldClose() && battleOngoing && roundNumber <= maxRounds) {
+    if (headless && options.checkpointPath == NULL && keyframes == NULL) {
+        battleRun(&battle);
+    } else if (headless) {
+        while (battleStep(&battle)) {
+            battleCheckpointIfDue(&battle, &options, &nextCheckpoint, false);
+            keyframeStoreRecord(keyframes, &battle);
+        }
+    }
+    while (!headless && !WindowShouldClose() && battle.outcome == BATTLE_ONGOING) {
         BeginDrawing();
         ClearBackground(RAYWHITE);
 
@@ -1130,6 +6301,8 @@ int main() {
         drawGrid(cellSize, rows, cols);
 
         // Birimleri yerletir
+        battleExportState(&battle, SIDE_HUMAN, insanImparatorlugu);
+        battleExportState(&battle, SIDE_ORC, orkLegionu);
         // nsan birimlerini yerletir (st tarafta, sol)
         placeUnitsInGrid(insanImparatorlugu, insanUnitCount, cellSize, 1, 1);
 
@@ -1138,207 +6311,61 @@ int main() {
 
         EndDrawing();
 
-        // Log and simulate the battle round
-        fprintf(logFile, "\n--- Round %d ---\n", roundNumber);
-
-        // Apply fatigue every 'fatigueFrequency' rounds
-        if (roundNumber % fatigueFrequency == 0) {
-            for (int i = 0; i < insanUnitCount; i++) {
-                applyFatigueEffect(&insanImparatorlugu[i].saldiri, &insanImparatorlugu[i].savunma, fatiguePercentage);
-            }
-            for (int i = 0; i < orkUnitCount; i++) {
-                applyFatigueEffect(&orkLegionu[i].saldiri, &orkLegionu[i].savunma, fatiguePercentage);
-            }
-            fprintf(logFile, "Yorgunluk devreye girdi: Tur %d, birimlerin saldr ve savunma gleri %%10 azald.\n", roundNumber);
-        }
-
         // Simulate the battle round
-        // HUMAN ATTACK
-        for (int i = 0; i < insanUnitCount; i++) {
-            if (insanImparatorlugu[i].kalanBirimSayisi > 0) {
-                // Increment attack count
-                attackCountHuman[i]++;
-                // Check for critical hit
-                bool isCritical = false;
-                if (attackCountHuman[i] >= critThresholdHuman[i]) {
-                    isCritical = true;
-                    attackCountHuman[i] = 0; // Reset counter after critical hit
-                }
-
-                // Calculate attack power
-                long long int attackPower = (long long int)insanImparatorlugu[i].saldiri * insanImparatorlugu[i].kalanBirimSayisi;
-                if (isCritical) {
-                    attackPower = (long long int)(attackPower * 1.5); // Increase by 50%
-                    fprintf(logFile, "Round %d: Human unit (%s) lands a SCHEDULED CRITICAL HIT! Attack power increased by 50%% to %lld.\n", roundNumber, insanImparatorlugu[i].isim, attackPower);
-                }
-
-                // Hedef Orc birimini se
-                int targetIndex = orkAttackIndex;
-                // Find the next available Orc unit
-                bool targetFound = false;
-                for (int k = 0; k < orkUnitCount; k++) {
-                    int currentIndex = (orkAttackIndex + k) % orkUnitCount;
-                    if (orkLegionu[currentIndex].kalanBirimSayisi > 0) {
-                        targetIndex = currentIndex;
-                        orkAttackIndex = (currentIndex + 1) % orkUnitCount;
-                        targetFound = true;
-                        break;
-                    }
-                }
-
-                if (targetFound) {
-                    // Hasar hesaplama
-                    long long int damage = calculateNetDamage(attackPower, (long long int)orkLegionu[targetIndex].savunma);
-                    orkLegionu[targetIndex].saglik -= damage;
-
-                    // Loglama
-                    fprintf(logFile, "Human unit (%s) attacks Orc unit (%s) for %lld damage.\n", insanImparatorlugu[i].isim, orkLegionu[targetIndex].isim, damage);
-
-                    // Orc biriminin lmesi durumunda
-                    if (orkLegionu[targetIndex].saglik <= 0) {
-                        orkLegionu[targetIndex].saglik = orkLegionu[targetIndex].maksimumSaglik;
-                        orkLegionu[targetIndex].kalanBirimSayisi--;
-                        fprintf(logFile, "Orc unit (%s) has been defeated. Remaining units: %lld\n", orkLegionu[targetIndex].isim, orkLegionu[targetIndex].kalanBirimSayisi);
-                    }
-                }
-            }
-        }
-
-        // ORC ATTACK
-        for (int i = 0; i < orkUnitCount; i++) {
-            if (orkLegionu[i].kalanBirimSayisi > 0) {
-                // Increment attack count
-                attackCountOrc[i]++;
-                // Check for critical hit
-                bool isCritical = false;
-                if (attackCountOrc[i] >= critThresholdOrc[i]) {
-                    isCritical = true;
-                    attackCountOrc[i] = 0; // Reset counter after critical hit
-                }
-
-                // Calculate attack power
-                long long int attackPower = (long long int)orkLegionu[i].saldiri * orkLegionu[i].kalanBirimSayisi;
-                if (isCritical) {
-                    attackPower = (long long int)(attackPower * 1.5); // Increase by 50%
-                    fprintf(logFile, "Round %d: Orc unit (%s) lands a SCHEDULED CRITICAL HIT! Attack power increased by 50%% to %lld.\n", roundNumber, orkLegionu[i].isim, attackPower);
-                }
-
-                // Hedef Human birimini se
-                int targetIndex = insanAttackIndex;
-                // Find the next available Human unit
-                bool targetFound = false;
-                for (int k = 0; k < insanUnitCount; k++) {
-                    int currentIndex = (insanAttackIndex + k) % insanUnitCount;
-                    if (insanImparatorlugu[currentIndex].kalanBirimSayisi > 0) {
-                        targetIndex = currentIndex;
-                        insanAttackIndex = (currentIndex + 1) % insanUnitCount;
-                        targetFound = true;
-                        break;
-                    }
-                }
-
-                if (targetFound) {
-                    // Hasar hesaplama
-                    long long int damage = calculateNetDamage(attackPower, (long long int)insanImparatorlugu[targetIndex].savunma);
-                    insanImparatorlugu[targetIndex].saglik -= damage;
-
-                    // Loglama
-                    fprintf(logFile, "Orc unit (%s) attacks Human unit (%s) for %lld damage.\n", orkLegionu[i].isim, insanImparatorlugu[targetIndex].isim, damage);
-
-                    // Human biriminin lmesi durumunda
-                    if (insanImparatorlugu[targetIndex].saglik <= 0) {
-                        insanImparatorlugu[targetIndex].saglik = insanImparatorlugu[targetIndex].maksimumSaglik;
-                        insanImparatorlugu[targetIndex].kalanBirimSayisi--;
-                        fprintf(logFile, "Human unit (%s) has been defeated. Remaining units: %lld\n", insanImparatorlugu[targetIndex].isim, insanImparatorlugu[targetIndex].kalanBirimSayisi);
-                    }
-                }
-            }
-        }
-
-        // Mevcut durumu logla
-        fprintf(logFile, "Status after Round %d:\n", roundNumber);
-        fprintf(logFile, "Humans:\n");
-        for (int i = 0; i < insanUnitCount; i++) {
-            fprintf(logFile, " - %s: %lld units remaining, Health per unit: %d\n", insanImparatorlugu[i].isim, insanImparatorlugu[i].kalanBirimSayisi, insanImparatorlugu[i].saglik);
-        }
+        battleStep(&battle);
+        battleCheckpointIfDue(&battle, &options, &nextCheckpoint, false);
+        keyframeStoreRecord(keyframes, &battle);
+    }
+    battleCheckpointIfDue(&battle, &options, &nextCheckpoint, true);
+    if (keyframes != NULL) {
+        keyframeStoreRecord(keyframes, &battle);
+        keyframeStoreSave(keyframes, options.keyframePath);
+        keyframeStoreFree(keyframes);
+    }
 
-        fprintf(logFile, "Orcs:\n");
-        for (int i = 0; i < orkUnitCount; i++) {
-            fprintf(logFile, " - %s: %lld units remaining, Health per unit: %d\n", orkLegionu[i].isim, orkLegionu[i].kalanBirimSayisi, orkLegionu[i].saglik);
-        }
+    double elapsedSeconds = (double)(clock() - battleStartTime) / CLOCKS_PER_SEC;
 
-        fprintf(logFile, "----------------------------------------\n");
+    // Clean up allocated memory
+    freeGameData(&gameData);
+    free(scenarioJson);
 
-        // Check if battle has ended
-        bool insanKaybetti = true;
-        for (int i = 0; i < insanUnitCount; i++) {
-            if (insanImparatorlugu[i].kalanBirimSayisi > 0) {
-                insanKaybetti = false;
-                break;
-            }
-        }
+    fclose(logFile);
+    curl_global_cleanup();
 
-        bool orkKaybetti = true;
-        for (int i = 0; i < orkUnitCount; i++) {
-            if (orkLegionu[i].kalanBirimSayisi > 0) {
-                orkKaybetti = false;
-                break;
-            }
+    if (headless) {
+        // Summary for batch runs: winner, rounds and survivors per unit type
+        printf("Battle summary\n");
+        printf("Rounds: %d\n", battle.roundsPlayed);
+        printf("Engine steps: %d\n", battle.stepCount);
+        printf("Winner: %s\n", battleWinnerName(&battle));
+        if (battle.options.randomCrits) {
+            printf("Seed: %llu\n", battle.options.seed);
         }
-
-        if (insanKaybetti || orkKaybetti) {
-            // Battle has ended, determine winner
-            if (insanKaybetti && orkKaybetti) {
-                fprintf(logFile, "\nBattle ended on round %d.\nIt's a draw!\n", roundNumber);
-            }
-            else if (insanKaybetti) {
-                fprintf(logFile, "\nBattle ended on round %d.\nOrcs win!\n", roundNumber);
-            }
-            else {
-                fprintf(logFile, "\nBattle ended on round %d.\nHumans win!\n", roundNumber);
-            }
-            battleOngoing = false;
+        if (battle.decidedRound > 0) {
+            printf("Decided at round: %d%s\n", battle.decidedRound, battle.stoppedEarly ? " (stopped early, unit counts are not final)" : "");
         }
-
-        // Check for maximum rounds to prevent infinite loops
-        if (roundNumber >= maxRounds) {
-            // Determine the winner based on total remaining units
-            long long int totalHumanUnits = 0;
-            for (int i = 0; i < insanUnitCount; i++) {
-                totalHumanUnits += insanImparatorlugu[i].kalanBirimSayisi;
-            }
-
-            long long int totalOrcUnits = 0;
-            for (int i = 0; i < orkUnitCount; i++) {
-                totalOrcUnits += orkLegionu[i].kalanBirimSayisi;
+        for (int s = 0; s < 2; s++) {
+            printf("%s:\n", battle.sides[s].cogulEtiket);
+            for (int i = 0; i < battle.sides[s].birimSayisi; i++) {
+                printf(" - %s: %lld units remaining\n", battle.sides[s].bilgi[i].isim, battle.sides[s].kalanBirimSayisi[i]);
             }
-
-            if (totalHumanUnits > totalOrcUnits) {
-                fprintf(logFile, "\nBattle ended after %d rounds.\nHumans win by remaining units!\n", roundNumber);
-            } else if (totalOrcUnits > totalHumanUnits) {
-                fprintf(logFile, "\nBattle ended after %d rounds.\nOrcs win by remaining units!\n", roundNumber);
-            } else {
-                fprintf(logFile, "\nBattle ended in a draw after %d rounds.\n", roundNumber);
-            }
-            break;
         }
-
-        roundNumber++;
+        printf("Simulation time: %.3f s\n", elapsedSeconds);
+        printf("Battle simulation completed. Check 'savas_sim.txt' for details.\n");
+        battleDestroy(&battle);
+        workerPoolDestroy(&workerPool);
+        free(insanImparatorlugu);
+        free(orkLegionu);
+        return 0;
     }
 
-    // Clean up allocated memory
-    free(unitTypesJson);
-    free(heroesJson);
-    free(creaturesJson);
-    free(researchJson);
-    free(scenarioJson);
-
     // Unload textures
     unloadInsanTextures(insanImparatorlugu, insanUnitCount);
     unloadOrkTextures(orkLegionu, orkUnitCount);
-
-    fclose(logFile);
-    curl_global_cleanup();
+    free(insanImparatorlugu);
+    free(orkLegionu);
+    battleDestroy(&battle);
+    workerPoolDestroy(&workerPool);
 
     printf("Battle simulation completed. Check 'savas_sim.txt' for details.\n");
 
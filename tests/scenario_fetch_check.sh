@@ -0,0 +1,116 @@
+#!/bin/sh
+# Checks --scenario-url and --prefetch against the stub server in
+# scenario_server.py: a first download is a miss, a repeat is revalidated with
+# a 304, and with the server gone the cached copy is used offline. Prefetch has
+# to overlap slow requests, report a missing file as failed, keep URLs whose
+# last path segments clash apart, and refuse a non-positive timeout.
+#
+#   sh tests/scenario_fetch_check.sh path/to/simulator [port]
+#
+# Only the summaries and the written files are checked, so the battle data
+# files do not have to be present. Needs python3.
+
+SIM=$1
+PORT=${2:-8765}
+HERE=$(cd "$(dirname "$0")" && pwd)
+if [ -z "$SIM" ] || [ ! -x "$SIM" ]; then
+    echo "usage: $0 path/to/simulator [port]" >&2
+    exit 2
+fi
+SIM=$(cd "$(dirname "$SIM")" && pwd)/$(basename "$SIM")
+
+WORK=$(mktemp -d)
+SERVER=
+cleanup() {
+    [ -n "$SERVER" ] && kill "$SERVER" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+mkdir "$WORK/site" "$WORK/run"
+cd "$WORK/run" || exit 2
+FAILED=0
+
+start_server() {
+    python3 "$HERE/scenario_server.py" "$PORT" "$WORK/site" &
+    SERVER=$!
+    for _ in $(seq 50); do
+        python3 -c "import socket; socket.create_connection(('127.0.0.1', $PORT), 1)" 2>/dev/null && return
+        sleep 0.1
+    done
+    echo "scenario server did not start on port $PORT" >&2
+    exit 2
+}
+
+stop_server() {
+    kill "$SERVER"
+    wait "$SERVER" 2>/dev/null
+    SERVER=
+}
+
+# check NAME EXPECTED COMMAND...: run the simulator, compare the cache summary
+check() {
+    name=$1
+    expected=$2
+    shift 2
+    summary=$("$@" 2>&1 | grep '^Scenario cache:' | sed 's/, [0-9]* of [0-9]* KB$//')
+    if [ "$summary" = "Scenario cache: $expected" ]; then
+        echo "ok    $name"
+    else
+        echo "FAIL  $name: got '$summary', expected 'Scenario cache: $expected'"
+        FAILED=1
+    fi
+}
+
+URL=http://127.0.0.1:$PORT/scenario.json
+FETCH="$SIM --headless --scenario-cache cache --scenario-url"
+echo '{ "insan_imparatorlugu": { "birimler": { "piyadeler": 10 } }, "ork_legi": { "birimler": { "troller": 1 } } }' > "$WORK/site/scenario.json"
+
+start_server
+check "first download" "0 hits (0 not modified, 0 offline), 1 misses, 0 evicted, 1 URLs" $FETCH "$URL"
+check "revalidated" "1 hits (1 not modified, 0 offline), 0 misses, 0 evicted, 1 URLs" $FETCH "$URL"
+echo '{ "insan_imparatorlugu": { "birimler": { "piyadeler": 20 } }, "ork_legi": { "birimler": { "troller": 1 } } }' > "$WORK/site/scenario.json"
+check "changed on the server" "0 hits (0 not modified, 0 offline), 1 misses, 0 evicted, 1 URLs" $FETCH "$URL"
+if ! grep -qs '"piyadeler": 20' selected_scenario.json; then
+    echo "FAIL  changed on the server: selected_scenario.json has the old body"
+    FAILED=1
+fi
+
+# Eight requests that take a second each, two files both named 1.json and one missing file
+mkdir "$WORK/site/a" "$WORK/site/b"
+echo '{ "from": "a" }' > "$WORK/site/a/1.json"
+echo '{ "from": "b" }' > "$WORK/site/b/1.json"
+: > list.txt
+for _ in $(seq 8); do echo "http://127.0.0.1:$PORT/scenario.json?delay=1" >> list.txt; done
+echo "http://127.0.0.1:$PORT/a/1.json" >> list.txt
+echo "http://127.0.0.1:$PORT/b/1.json" >> list.txt
+echo "http://127.0.0.1:$PORT/missing.json" >> list.txt
+mkdir out
+summary=$("$SIM" --no-scenario-cache --prefetch list.txt --prefetch-output out/ --prefetch-parallel 8 2>&1 >/dev/null | grep '^Prefetch:')
+case "$summary" in
+"Prefetch: 11 URLs, 1 failed, 8 in flight at most, "*) echo "ok    prefetch summary" ;;
+*) echo "FAIL  prefetch summary: got '$summary'"; FAILED=1 ;;
+esac
+seconds=$(echo "$summary" | sed 's/.*, \([0-9.]*\) s$/\1/')
+if awk "BEGIN { exit !($seconds < 4) }" 2>/dev/null; then
+    echo "ok    prefetch overlaps requests ($seconds s for 8 s of delays)"
+else
+    echo "FAIL  prefetch overlaps requests: took '$seconds' s"
+    FAILED=1
+fi
+if grep -qs '"a"' out/1.json && grep -qs '"b"' out/1_10.json && [ "$(ls out | wc -l)" -eq 10 ]; then
+    echo "ok    prefetch keeps clashing names apart"
+else
+    echo "FAIL  prefetch keeps clashing names apart: out has $(ls out | tr '\n' ' ')"
+    FAILED=1
+fi
+if "$SIM" --prefetch list.txt --prefetch-timeout 0 2>&1 >/dev/null | grep -q '^Invalid prefetch timeout'; then
+    echo "ok    prefetch refuses a zero timeout"
+else
+    echo "FAIL  prefetch refuses a zero timeout"
+    FAILED=1
+fi
+
+stop_server
+check "offline" "1 hits (0 not modified, 1 offline), 0 misses, 0 evicted, 1 URLs" $FETCH "$URL"
+
+exit $FAILED
@@ -0,0 +1,55 @@
+# Stub scenario server for scenario_fetch_check.sh: serves the files of a
+# directory with an ETag, answers a matching If-None-Match with 304, and
+# waits ?delay=S seconds before answering to stand in for a slow link.
+#
+#   python3 scenario_server.py PORT DIRECTORY
+
+import hashlib
+import http.server
+import os
+import sys
+import time
+
+
+class ScenarioHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        pass
+
+    def do_GET(self):
+        path, _, query = self.path.partition('?')
+        if query.startswith('delay='):
+            time.sleep(float(query[len('delay='):]))
+        file = os.path.join(self.server.directory, path.lstrip('/'))
+        if not os.path.isfile(file):
+            self.send_response(404)
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+            return
+        with open(file, 'rb') as f:
+            body = f.read()
+        etag = '"%s"' % hashlib.md5(body).hexdigest()
+        if self.headers.get('If-None-Match') == etag:
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+        self.send_response(200)
+        self.send_header('ETag', etag)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+
+class ScenarioServer(http.server.ThreadingHTTPServer):
+    # Prefetch opens many connections at once; the default backlog of 5 would serialize them
+    request_queue_size = 64
+    daemon_threads = True
+
+
+if __name__ == '__main__':
+    server = ScenarioServer(('127.0.0.1', int(sys.argv[1])), ScenarioHandler)
+    server.directory = sys.argv[2]
+    server.serve_forever()